@@ -14,7 +14,20 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <type_traits>
+
+#if __unix__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace TemAllocator
 {
@@ -24,9 +37,15 @@ namespace TemAllocator
 	enum class PlacementPolicy
 	{
 		First, ///< Find first block that is big enough the handle the allocation request. The faster policy.
-		Best
+		Best,
 		///< Find smallest block that is big enough the handle the allocation request. Reduces chance of fragmentation
 		///< in heap. The slower policy
+		Next,
+		///< Like First but start where the last search stopped. Small blocks left at the front of the list are not
+		///< stepped over on every allocation
+		Good
+		///< Like Best but stop at a block that is within a slack of the request or after visiting a number of nodes.
+		///< See #TemAllocator::GoodFit
 	};
 	/**
 	 * @brief Linked list used by free list allocator
@@ -60,211 +79,1370 @@ namespace TemAllocator
 				previous->next = deleteNode->next;
 			}
 		}
+
+		/**
+		 * @brief See #TemAllocator::PlacementPolicy::First
+		 *
+		 * @param head the list
+		 * @param size Requested memory block size
+		 * @param previousNode [out] the node before the foundNode
+		 * @param foundNode [out] the node that contains the request memory block
+		 */
+		static void findFirst(FreeListNode *head, const size_t size, FreeListNode *&previousNode,
+							  FreeListNode *&foundNode) noexcept
+		{
+			FreeListNode *it = head;
+			FreeListNode *prev = nullptr;
+			while (it != nullptr)
+			{
+				if (it->blockSize >= size)
+				{
+					break;
+				}
+				prev = it;
+				it = it->next;
+			}
+			previousNode = prev;
+			foundNode = it;
+		}
+
+		/**
+		 * @brief See #TemAllocator::PlacementPolicy::Next
+		 *
+		 * @param head the list
+		 * @param rover the node after which the search starts. Null starts at the head
+		 * @param size Requested memory block size
+		 * @param previousNode [out] the node before the foundNode
+		 * @param foundNode [out] the node that contains the request memory block
+		 */
+		static void findNext(FreeListNode *head, FreeListNode *rover, const size_t size, FreeListNode *&previousNode,
+							 FreeListNode *&foundNode) noexcept
+		{
+			FreeListNode *prev = rover;
+			FreeListNode *it = rover == nullptr ? head : rover->next;
+			while (it != nullptr)
+			{
+				if (it->blockSize >= size)
+				{
+					previousNode = prev;
+					foundNode = it;
+					return;
+				}
+				prev = it;
+				it = it->next;
+			}
+
+			// Wrap around and search up to (and including) the rover
+			prev = nullptr;
+			it = rover == nullptr ? nullptr : head;
+			while (it != nullptr)
+			{
+				if (it->blockSize >= size)
+				{
+					break;
+				}
+				if (it == rover)
+				{
+					it = nullptr;
+					break;
+				}
+				prev = it;
+				it = it->next;
+			}
+			previousNode = prev;
+			foundNode = it;
+		}
+
+		/**
+		 * @brief See #TemAllocator::PlacementPolicy::Best
+		 *
+		 * @param head the list
+		 * @param size Requested memory block size
+		 * @param previousNode [out] the node before the foundNode
+		 * @param foundNode [out] the node that contains the request memory block
+		 */
+		static void findBest(FreeListNode *head, const size_t size, FreeListNode *&previousNode,
+							 FreeListNode *&foundNode) noexcept
+		{
+			size_t smallestDiff = std::numeric_limits<size_t>::max();
+			FreeListNode *bestBlock = nullptr;
+			FreeListNode *bestPrevBlock = nullptr;
+			FreeListNode *it = head;
+			FreeListNode *prev = nullptr;
+			while (it != nullptr)
+			{
+				const size_t currentDiff = it->blockSize - size;
+				if (it->blockSize >= size && currentDiff < smallestDiff)
+				{
+					bestBlock = it;
+					bestPrevBlock = prev;
+					smallestDiff = currentDiff;
+					// No other block can be better
+					if (currentDiff == 0)
+					{
+						break;
+					}
+				}
+				prev = it;
+				it = it->next;
+			}
+			previousNode = bestPrevBlock;
+			foundNode = bestBlock;
+		}
 	};
 
-	template <class T>
-	class Allocator;
+	/**
+	 * @brief Placement policy fixed at compile time to #TemAllocator::PlacementPolicy::First
+	 */
+	struct FirstFit
+	{
+		void setPolicy(const PlacementPolicy) noexcept
+		{
+		}
+
+		PlacementPolicy getPolicy() const noexcept
+		{
+			return PlacementPolicy::First;
+		}
+
+		void reset() noexcept
+		{
+		}
+
+		void remove(FreeListNode *, FreeListNode *) noexcept
+		{
+		}
+
+		void find(FreeListNode *list, const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode) noexcept
+		{
+			FreeListNode::findFirst(list, size, previousNode, foundNode);
+		}
+	};
 
 	/**
-	 * @brief Data passed to all free list allocators
+	 * @brief Placement policy fixed at compile time to #TemAllocator::PlacementPolicy::Best
 	 */
-	class AllocatorData
+	struct BestFit
 	{
-	private:
-		using Mutex = std::recursive_mutex;
-		Mutex mutex;
-		FreeListNode *list;
-		void *data;
-		size_t used;
-		size_t len;
-		size_t allocationNum;
-		PlacementPolicy policy;
+		void setPolicy(const PlacementPolicy) noexcept
+		{
+		}
 
-		template <class T>
-		friend class Allocator;
+		PlacementPolicy getPolicy() const noexcept
+		{
+			return PlacementPolicy::Best;
+		}
 
-		void reset()
+		void reset() noexcept
 		{
-			FreeListNode *first = reinterpret_cast<FreeListNode *>(data);
-			first->blockSize = len;
-			first->next = nullptr;
-			used = 0;
-			list = nullptr;
-			FreeListNode::insert(list, nullptr, first);
 		}
 
-		void close()
+		void remove(FreeListNode *, FreeListNode *) noexcept
 		{
-			if (data != nullptr)
-			{
-				free(data);
-				data = nullptr;
-			}
+		}
+
+		void find(FreeListNode *list, const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode) noexcept
+		{
+			FreeListNode::findBest(list, size, previousNode, foundNode);
+		}
+	};
+
+	/**
+	 * @brief Placement policy fixed at compile time to #TemAllocator::PlacementPolicy::Next
+	 */
+	struct NextFit
+	{
+		// The node after which the next search starts
+		FreeListNode *rover = nullptr;
+
+		void setPolicy(const PlacementPolicy) noexcept
+		{
+		}
+
+		PlacementPolicy getPolicy() const noexcept
+		{
+			return PlacementPolicy::Next;
+		}
+
+		void reset() noexcept
+		{
+			rover = nullptr;
 		}
 
 		/**
-		 * @brief Combine memory blocks if possible
+		 * @brief Called before a node is removed from the list. Moves the rover back if it is the removed node
 		 *
-		 * @param previousNode Node that came before freeNode
-		 * @param freeNode Node that was just re-inserted into memory blcok
+		 * @param previous the node before the removed node
+		 * @param node the removed node
 		 */
-		void coalescence(FreeListNode *previousNode, FreeListNode *freeNode)
+		void remove(FreeListNode *previous, FreeListNode *node) noexcept
 		{
-			if (freeNode->next != nullptr &&
-				reinterpret_cast<size_t>(freeNode) + freeNode->blockSize == reinterpret_cast<size_t>(freeNode->next))
+			if (rover == node)
 			{
-				freeNode->blockSize += freeNode->next->blockSize;
-				FreeListNode::remove(list, freeNode, freeNode->next);
+				rover = previous;
 			}
-			if (previousNode != nullptr &&
-				reinterpret_cast<size_t>(previousNode) + previousNode->blockSize == reinterpret_cast<size_t>(freeNode))
+		}
+
+		void find(FreeListNode *list, const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode) noexcept
+		{
+			FreeListNode::findNext(list, rover, size, previousNode, foundNode);
+			if (foundNode != nullptr)
 			{
-				previousNode->blockSize += freeNode->blockSize;
-				FreeListNode::remove(list, previousNode, freeNode);
+				// The rest of the found block (or the block after it) is where the next search starts
+				rover = previousNode;
+			}
+		}
+	};
+
+	/**
+	 * Default difference in bytes between a block and the request that is good enough for #TemAllocator::GoodFit. Tuned
+	 * with churn_benchmark.cpp: any slack leaves small blocks behind that make the free list longer, and freeing walks
+	 * the list. So, only exact matches stop the search early by default
+	 */
+	constexpr size_t DefaultGoodFitSlack = 0;
+
+	/**
+	 * Default number of nodes #TemAllocator::GoodFit visits before it takes the best block so far. Tuned with
+	 * churn_benchmark.cpp. Smaller caps fragment the heap almost as much as First
+	 */
+	constexpr size_t DefaultGoodFitVisits = 1024;
+
+	/**
+	 * @brief How #TemAllocator::GoodFit searches ended
+	 */
+	struct GoodFitStats
+	{
+		size_t searches;
+		// Stopped at a block of the requested size
+		size_t exactMatches;
+		// Stopped at a block within the slack
+		size_t slackMatches;
+		// Visited the maximum number of nodes before a good enough block was found
+		size_t capHits;
+	};
+
+	/**
+	 * @brief Placement policy fixed at compile time to #TemAllocator::PlacementPolicy::Good. Finds the smallest block
+	 * that is big enough but stops at a block within the slack of the request or after visiting a maximum number of
+	 * nodes. When no block fits by then, the first block that fits after it is taken.
+	 */
+	struct GoodFit
+	{
+		size_t slack = DefaultGoodFitSlack;
+		size_t maxVisits = DefaultGoodFitVisits;
+		GoodFitStats stats = {};
+
+		void setPolicy(const PlacementPolicy) noexcept
+		{
+		}
+
+		PlacementPolicy getPolicy() const noexcept
+		{
+			return PlacementPolicy::Good;
+		}
+
+		void reset() noexcept
+		{
+		}
+
+		void remove(FreeListNode *, FreeListNode *) noexcept
+		{
+		}
+
+		GoodFit &getGoodFit() noexcept
+		{
+			return *this;
+		}
+
+		void find(FreeListNode *list, const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode) noexcept
+		{
+			++stats.searches;
+			size_t smallestDiff = std::numeric_limits<size_t>::max();
+			FreeListNode *bestBlock = nullptr;
+			FreeListNode *bestPrevBlock = nullptr;
+			FreeListNode *it = list;
+			FreeListNode *prev = nullptr;
+			size_t visits = 0;
+			while (it != nullptr)
+			{
+				if (visits == maxVisits)
+				{
+					++stats.capHits;
+					if (bestBlock != nullptr)
+					{
+						break;
+					}
+					// Nothing fits yet. Take the first block that does
+					FreeListNode::findFirst(it, size, previousNode, foundNode);
+					if (foundNode != nullptr && previousNode == nullptr)
+					{
+						previousNode = prev;
+					}
+					return;
+				}
+				++visits;
+
+				const size_t currentDiff = it->blockSize - size;
+				if (it->blockSize >= size && currentDiff < smallestDiff)
+				{
+					bestBlock = it;
+					bestPrevBlock = prev;
+					smallestDiff = currentDiff;
+					if (currentDiff == 0)
+					{
+						++stats.exactMatches;
+						break;
+					}
+					if (currentDiff <= slack)
+					{
+						++stats.slackMatches;
+						break;
+					}
+				}
+				prev = it;
+				it = it->next;
+			}
+			previousNode = bestPrevBlock;
+			foundNode = bestBlock;
+		}
+	};
+
+	/**
+	 * @brief Placement policy chosen when the data is initialized
+	 */
+	struct RuntimePlacement
+	{
+		PlacementPolicy policy = PlacementPolicy::Best;
+		NextFit next;
+		GoodFit good;
+
+		void setPolicy(const PlacementPolicy policy) noexcept
+		{
+			this->policy = policy;
+		}
+
+		PlacementPolicy getPolicy() const noexcept
+		{
+			return policy;
+		}
+
+		void reset() noexcept
+		{
+			next.reset();
+		}
+
+		void remove(FreeListNode *previous, FreeListNode *node) noexcept
+		{
+			next.remove(previous, node);
+		}
+
+		GoodFit &getGoodFit() noexcept
+		{
+			return good;
+		}
+
+		void find(FreeListNode *list, const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode) noexcept
+		{
+			switch (policy)
+			{
+			case PlacementPolicy::First:
+				FreeListNode::findFirst(list, size, previousNode, foundNode);
+				break;
+			case PlacementPolicy::Next:
+				next.find(list, size, previousNode, foundNode);
+				break;
+			case PlacementPolicy::Good:
+				good.find(list, size, previousNode, foundNode);
+				break;
+			case PlacementPolicy::Best:
+				FreeListNode::findBest(list, size, previousNode, foundNode);
+				break;
+			default:
+				break;
 			}
 		}
+	};
+
+	/**
+	 * @brief Lock for data that is only used by one thread
+	 */
+	struct NullLock
+	{
+		void lock() noexcept
+		{
+		}
+		bool try_lock() noexcept
+		{
+			return true;
+		}
+		void unlock() noexcept
+		{
+		}
+	};
+
+	template <class Policy, class Lock>
+	class BasicAllocatorData;
+
+	/**
+	 * @brief Free list data with the placement policy chosen at runtime. Used by everything that does not pick its own
+	 */
+	using AllocatorData = BasicAllocatorData<RuntimePlacement, std::recursive_mutex>;
+
+	template <class T, class Data = AllocatorData>
+	class Allocator;
+
+#if __cpp_lib_allocate_at_least
+	template <class Pointer>
+	using allocation_result = std::allocation_result<Pointer>;
+#else
+	/**
+	 * @brief Result of allocate_at_least (std::allocation_result before C++23)
+	 */
+	template <class Pointer>
+	struct allocation_result
+	{
+		Pointer ptr;
+		size_t count;
+	};
+#endif
+
+	constexpr size_t MinimumAllocationSize = 16;
+
+	/**
+	 * Freed blocks up to this size (header included) are kept in quick lists by size instead of being combined with
+	 * their neighbors
+	 */
+	constexpr size_t QuickListMaxSize = 256;
+	constexpr size_t QuickListClasses = QuickListMaxSize / MinimumAllocationSize;
+
+	/**
+	 * Default number of bytes the quick lists can hold before they are consolidated
+	 */
+	constexpr size_t DefaultQuickListThreshold = 1 << 20;
+
+	/**
+	 * Limit that is never reached
+	 */
+	constexpr size_t NoMemoryLimit = std::numeric_limits<size_t>::max();
+
+	/**
+	 * Maximum number of pressure callbacks per arena
+	 */
+	constexpr size_t MaxPressureCallbacks = 8;
+
+	/**
+	 * @brief Called when an arena is under memory pressure. It is called with the arena lock held. It may free memory
+	 * into the arena but must not wait for other threads that use it or throw.
+	 *
+	 * @param user the pointer passed when the callback was added
+	 * @param requested bytes the allocation that caused the pressure needs
+	 */
+	typedef void (*PressureCallback)(void *user, size_t requested);
+
+	/**
+	 * @brief Called by allocate and reallocate when there is not enough memory (see
+	 * #TemAllocator::BasicAllocatorData::setOutOfMemoryHandler). It is called without the arena lock held.
+	 *
+	 * @param user the pointer passed when the handler was set
+	 * @param requested bytes that were requested
+	 *
+	 * @return true to try the allocation again. false to throw #TemAllocator::bad_alloc
+	 */
+	typedef bool (*OutOfMemoryHandler)(void *user, size_t requested);
+
+	/**
+	 * Number of allocation tags each arena counts. Larger tags wrap around
+	 */
+	constexpr size_t MaxAllocationTags = 16;
+
+	static_assert((MaxAllocationTags & (MaxAllocationTags - 1)) == 0, "MaxAllocationTags must be a power of two");
+
+	/**
+	 * @brief Memory counted for one allocation tag (headers included)
+	 */
+	struct TagStats
+	{
+		size_t liveBytes;
+		size_t peakBytes;
+		size_t allocations;
+		size_t deallocations;
+	};
+
+	/**
+	 * @brief Tags allocations made on the current thread until the scope ends. The tag is stored in the header of each
+	 * block so the memory is counted against it when it is freed on any thread. Scopes can be nested. Tag 0 is used
+	 * outside of any scope.
+	 */
+	class ScopedTag
+	{
+	private:
+		size_t previous;
+
+		static size_t &slot() noexcept
+		{
+			// Read on every allocation, including from inside malloc (see tem_malloc.cpp). So, it must not need
+			// allocating to be accessed
+#if __GNUC__
+			static __attribute__((tls_model("initial-exec"))) thread_local size_t tag = 0;
+#else
+			static thread_local size_t tag = 0;
+#endif
+			return tag;
+		}
+
+	public:
+		explicit ScopedTag(const size_t tag) noexcept : previous(slot())
+		{
+			slot() = tag;
+		}
+		ScopedTag(const ScopedTag &) = delete;
+		ScopedTag(ScopedTag &&) = delete;
+
+		~ScopedTag()
+		{
+			slot() = previous;
+		}
+
+		/**
+		 * @brief Get the tag of the innermost scope on this thread
+		 *
+		 * @return the tag
+		 */
+		static size_t current() noexcept
+		{
+			return slot() & (MaxAllocationTags - 1);
+		}
+	};
+
+	/**
+	 * @brief Data passed to all free list allocators
+	 *
+	 * @tparam Policy Finds free blocks (i.e. #TemAllocator::FirstFit, #TemAllocator::NextFit, #TemAllocator::BestFit,
+	 * #TemAllocator::GoodFit or #TemAllocator::RuntimePlacement). A fixed policy lets the search be inlined into the allocation.
+	 * @tparam Lock Guards the data. Must be recursive (or #TemAllocator::NullLock when only one thread uses the data)
+	 */
+	template <class Policy, class Lock>
+	class BasicAllocatorData
+	{
+	private:
+		using Mutex = Lock;
+		Mutex mutex;
+		FreeListNode *list;
+		void *data;
+		size_t used;
+		size_t len;
+		size_t allocationNum;
+		Policy placement;
+		bool ownsData;
+		// Memory from this address to the end is known to be zero
+		size_t zeroStart;
+		// Freed pages read back as zero (i.e. anonymous memory)
+		bool purgeable;
+		// Recently freed blocks of one size each. Not part of list, used or allocationNum
+		FreeListNode *quickLists[QuickListClasses];
+		size_t quickListBytes;
+		size_t quickListThreshold;
+		// Soft limit is never above the hard limit. Can be changed without the lock
+		std::atomic<size_t> softLimit;
+		std::atomic<size_t> hardLimit;
+		// Set when the soft limit was crossed. Cleared when the memory in use drops below it again
+		bool underPressure;
+		size_t pressureRetries;
+		size_t pressureCallbackCount;
+		PressureCallback pressureCallbacks[MaxPressureCallbacks];
+		void *pressureUsers[MaxPressureCallbacks];
+		TagStats tagStats[MaxAllocationTags];
+		OutOfMemoryHandler outOfMemoryHandler;
+		void *outOfMemoryUser;
+
+		template <class T, class D>
+		friend class Allocator;
+		friend class PersistentHeap;
+		friend class RelocatableHeap;
+
+		void reset()
+		{
+			FreeListNode *first = reinterpret_cast<FreeListNode *>(data);
+			first->blockSize = len;
+			first->next = nullptr;
+			used = 0;
+			list = nullptr;
+			FreeListNode::insert(list, nullptr, first);
+			for (size_t i = 0; i < QuickListClasses; ++i)
+			{
+				quickLists[i] = nullptr;
+			}
+			quickListBytes = 0;
+			underPressure = false;
+			for (size_t i = 0; i < MaxAllocationTags; ++i)
+			{
+				tagStats[i] = TagStats();
+			}
+			placement.reset();
+		}
+
+		/**
+		 * @brief Re-create state that is only valid in the process that created it. Used when the data was mapped from
+		 * a file
+		 */
+		void reattach() noexcept
+		{
+			new (&mutex) Mutex();
+			// Callbacks point into the process that added them
+			pressureCallbackCount = 0;
+			outOfMemoryHandler = nullptr;
+			outOfMemoryUser = nullptr;
+		}
+
+		void close()
+		{
+			if (data != nullptr && ownsData)
+			{
+				free(data);
+			}
+			data = nullptr;
+			ownsData = false;
+			zeroStart = 0;
+			purgeable = false;
+		}
+
+		/**
+		 * @brief Count a block that was just allocated against the current tag and store the tag in its header. The
+		 * next field of an allocated block is not used otherwise.
+		 *
+		 * @param node the block
+		 */
+		void recordAllocation(FreeListNode *node) noexcept
+		{
+			const size_t tag = ScopedTag::current();
+			node->next = reinterpret_cast<FreeListNode *>(tag);
+			TagStats &stats = tagStats[tag];
+			stats.liveBytes += node->blockSize;
+			++stats.allocations;
+			if (stats.liveBytes > stats.peakBytes)
+			{
+				stats.peakBytes = stats.liveBytes;
+			}
+		}
+
+		/**
+		 * @brief Count a block that is about to be freed against the tag it was allocated with
+		 *
+		 * @param node the block
+		 */
+		void recordDeallocation(const FreeListNode *node) noexcept
+		{
+			TagStats &stats = tagStats[reinterpret_cast<size_t>(node->next) & (MaxAllocationTags - 1)];
+			stats.liveBytes -= node->blockSize;
+			++stats.deallocations;
+		}
+
+		/**
+		 * @brief Change the size of an allocated block and update the counters
+		 *
+		 * @param node the block
+		 * @param newBlockSize the new size (header included)
+		 */
+		void resizeBlock(FreeListNode *node, const size_t newBlockSize) noexcept
+		{
+			TagStats &stats = tagStats[reinterpret_cast<size_t>(node->next) & (MaxAllocationTags - 1)];
+			used -= node->blockSize;
+			used += newBlockSize;
+			stats.liveBytes -= node->blockSize;
+			stats.liveBytes += newBlockSize;
+			if (stats.liveBytes > stats.peakBytes)
+			{
+				stats.peakBytes = stats.liveBytes;
+			}
+			node->blockSize = newBlockSize;
+		}
+
+		/**
+		 * @brief Call every pressure callback
+		 *
+		 * @param requested bytes the allocation needs
+		 */
+		void notifyPressure(const size_t requested)
+		{
+			for (size_t i = 0; i < pressureCallbackCount; ++i)
+			{
+				pressureCallbacks[i](pressureUsers[i], requested);
+			}
+		}
+
+		/**
+		 * @brief Check that more memory can be used. Only a relaxed atomic load and a compare when under the soft
+		 * limit.
+		 *
+		 * @param bytes the memory that will be used
+		 *
+		 * @return true if the memory can be used
+		 */
+		bool checkLimits(const size_t bytes)
+		{
+			if (used + bytes <= softLimit.load(std::memory_order_relaxed))
+			{
+				return true;
+			}
+			return checkLimitsSlow(bytes);
+		}
+
+		/**
+		 * @brief Crossing the soft limit calls the callbacks once. Going over the hard limit calls them up to the
+		 * number of retries until enough memory was freed
+		 *
+		 * @param bytes the memory that will be used
+		 *
+		 * @return true if the memory can be used
+		 */
+		bool checkLimitsSlow(const size_t bytes)
+		{
+			if (used + bytes <= hardLimit.load(std::memory_order_relaxed))
+			{
+				if (!underPressure)
+				{
+					underPressure = true;
+					notifyPressure(bytes);
+				}
+				return true;
+			}
+			for (size_t i = 0; i < pressureRetries && used + bytes > hardLimit.load(std::memory_order_relaxed); ++i)
+			{
+				notifyPressure(bytes);
+			}
+			return used + bytes <= hardLimit.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Note that memory up to an address may have been written
+		 *
+		 * @param end the address
+		 */
+		void markDirty(const size_t end) noexcept
+		{
+			zeroStart = std::max(zeroStart, end);
+		}
+
+		/**
+		 * @brief Remove a node from the list. The placement policy is told first so it does not keep the node
+		 *
+		 * @param previous the node before the removed node
+		 * @param node the removed node
+		 */
+		void removeNode(FreeListNode *previous, FreeListNode *node) noexcept
+		{
+			placement.remove(previous, node);
+			FreeListNode::remove(list, previous, node);
+		}
+
+		/**
+		 * @brief Combine memory blocks if possible
+		 *
+		 * @param previousNode Node that came before freeNode
+		 * @param freeNode Node that was just re-inserted into memory blcok
+		 */
+		void coalescence(FreeListNode *previousNode, FreeListNode *freeNode)
+		{
+			if (freeNode->next != nullptr &&
+				reinterpret_cast<size_t>(freeNode) + freeNode->blockSize == reinterpret_cast<size_t>(freeNode->next))
+			{
+				freeNode->blockSize += freeNode->next->blockSize;
+				removeNode(freeNode, freeNode->next);
+			}
+			if (previousNode != nullptr &&
+				reinterpret_cast<size_t>(previousNode) + previousNode->blockSize == reinterpret_cast<size_t>(freeNode))
+			{
+				previousNode->blockSize += freeNode->blockSize;
+				removeNode(previousNode, freeNode);
+			}
+		}
+
+		/**
+		 * @brief Insert a free block into the list sorted by address and combine it with its neighbors
+		 *
+		 * @param freeNode the block
+		 */
+		void insertFreeNode(FreeListNode *freeNode)
+		{
+			freeNode->next = nullptr;
+
+			FreeListNode *it = list;
+			FreeListNode *prev = nullptr;
+
+			// Insert the block back into the list at the right spot
+			while (it != nullptr)
+			{
+				if (freeNode < it)
+				{
+					break;
+				}
+				prev = it;
+				it = it->next;
+			}
+			// The block may come after every free block (i.e. the end of the heap was in use)
+			FreeListNode::insert(list, prev, freeNode);
+
+			// Combine adjacent blocks into one
+			coalescence(prev, freeNode);
+		}
+
+		/**
+		 * @brief Free a block. Small blocks go to the quick list of their size without being combined with their
+		 * neighbors. The quick lists are consolidated once they hold more than the threshold.
+		 *
+		 * @param freeNode the block
+		 */
+		void freeBlock(FreeListNode *freeNode)
+		{
+			if (freeNode->blockSize > QuickListMaxSize)
+			{
+				insertFreeNode(freeNode);
+				return;
+			}
+			FreeListNode *&quick = quickLists[freeNode->blockSize / MinimumAllocationSize - 1];
+			freeNode->next = quick;
+			quick = freeNode;
+			quickListBytes += freeNode->blockSize;
+			if (quickListBytes > quickListThreshold)
+			{
+				consolidateQuickLists();
+			}
+		}
+
+		/**
+		 * @brief Take a block from the quick list of a size
+		 *
+		 * @param size Requested memory block size (header included)
+		 *
+		 * @return the block or nullptr if the list is empty
+		 */
+		FreeListNode *popQuickList(const size_t size) noexcept
+		{
+			if (size > QuickListMaxSize)
+			{
+				return nullptr;
+			}
+			FreeListNode *&quick = quickLists[size / MinimumAllocationSize - 1];
+			FreeListNode *node = quick;
+			if (node != nullptr)
+			{
+				quick = node->next;
+				node->next = nullptr;
+				quickListBytes -= node->blockSize;
+			}
+			return node;
+		}
+
+		/**
+		 * @brief Sort a linked list of blocks by address (merge sort)
+		 *
+		 * @param head first block
+		 *
+		 * @return first block of the sorted list
+		 */
+		static FreeListNode *sortByAddress(FreeListNode *head) noexcept
+		{
+			if (head == nullptr || head->next == nullptr)
+			{
+				return head;
+			}
+			FreeListNode *slow = head;
+			for (FreeListNode *fast = head->next; fast != nullptr && fast->next != nullptr; fast = fast->next->next)
+			{
+				slow = slow->next;
+			}
+			FreeListNode *a = head;
+			FreeListNode *b = slow->next;
+			slow->next = nullptr;
+			a = sortByAddress(a);
+			b = sortByAddress(b);
+
+			FreeListNode *sorted = nullptr;
+			FreeListNode **tail = &sorted;
+			while (a != nullptr && b != nullptr)
+			{
+				FreeListNode *&smaller = a < b ? a : b;
+				*tail = smaller;
+				tail = &smaller->next;
+				smaller = smaller->next;
+			}
+			*tail = a != nullptr ? a : b;
+			return sorted;
+		}
+
+		/**
+		 * @brief Insert blocks into the free list and combine them with their neighbors. The blocks are sorted first so
+		 * the free list is walked once for all of them
+		 *
+		 * @param blocks linked list of blocks
+		 */
+		void insertFreeNodes(FreeListNode *blocks)
+		{
+			blocks = sortByAddress(blocks);
+			FreeListNode *prev = nullptr;
+			FreeListNode *it = list;
+			while (blocks != nullptr)
+			{
+				FreeListNode *freeNode = blocks;
+				blocks = blocks->next;
+
+				// Continue from where the previous block was inserted
+				while (it != nullptr && it < freeNode)
+				{
+					prev = it;
+					it = it->next;
+				}
+				FreeListNode::insert(list, prev, freeNode);
+
+				const bool mergesPrevious = prev != nullptr && reinterpret_cast<size_t>(prev) + prev->blockSize ==
+																   reinterpret_cast<size_t>(freeNode);
+				coalescence(prev, freeNode);
+				if (!mergesPrevious)
+				{
+					prev = freeNode;
+				}
+				it = prev->next;
+			}
+		}
+
+		/**
+		 * @brief Move every block in the quick lists back into the free list so it can be combined with its neighbors
+		 */
+		void consolidateQuickLists()
+		{
+			FreeListNode *blocks = nullptr;
+			for (size_t i = 0; i < QuickListClasses; ++i)
+			{
+				while (quickLists[i] != nullptr)
+				{
+					FreeListNode *node = quickLists[i];
+					quickLists[i] = node->next;
+					node->next = blocks;
+					blocks = node;
+				}
+			}
+			quickListBytes = 0;
+			insertFreeNodes(blocks);
+		}
+
+		/**
+		 * @brief Find a valid memory block
+		 *
+		 * @param size Requested memory block size
+		 * @param previousNode [out] the node before the foundNode
+		 * @param foundNode [out] the node that contains the request memory block
+		 */
+		void find(const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode)
+		{
+			placement.find(list, size, previousNode, foundNode);
+		}
+
+	public:
+		BasicAllocatorData() noexcept
+			: mutex(), list(nullptr), data(nullptr), used(0), len(0),
+			  allocationNum(0), placement(), ownsData(false), zeroStart(0),
+			  purgeable(false), quickLists(), quickListBytes(0), quickListThreshold(DefaultQuickListThreshold),
+			  softLimit(NoMemoryLimit), hardLimit(NoMemoryLimit), underPressure(false), pressureRetries(0),
+			  pressureCallbackCount(0), pressureCallbacks(), pressureUsers(), tagStats(), outOfMemoryHandler(nullptr),
+			  outOfMemoryUser(nullptr)
+		{
+		}
+		BasicAllocatorData(const BasicAllocatorData &) = delete;
+		BasicAllocatorData(BasicAllocatorData &&) = delete;
+
+		~BasicAllocatorData()
+		{
+			close();
+		}
+
+		/**
+		 * @brief Get total availble memory
+		 *
+		 * @return total available memory in bytes
+		 */
+		size_t getTotal() const
+		{
+			return len;
+		}
+
+		/**
+		 * @brief Get amount of memory currently in use
+		 *
+		 * @return memory in use in bytes
+		 */
+		size_t getUsed() const
+		{
+			return used;
+		}
+
+		/**
+		 * @brief Get number of allocation calls
+		 *
+		 * @return Number of allocation calls
+		 */
+		size_t getNum() const
+		{
+			return allocationNum;
+		}
+
+		/**
+		 * @brief Limit the memory in use (headers included). Going over the soft limit calls the pressure callbacks.
+		 * Allocations that would go over the hard limit fail. Can be called from any thread.
+		 *
+		 * @param soft the soft limit in bytes. Lowered to the hard limit if it is above it
+		 * @param hard the hard limit in bytes
+		 */
+		void setLimits(const size_t soft, const size_t hard = NoMemoryLimit) noexcept
+		{
+			hardLimit.store(hard, std::memory_order_relaxed);
+			softLimit.store(std::min(soft, hard), std::memory_order_relaxed);
+		}
+
+		size_t getSoftLimit() const noexcept
+		{
+			return softLimit.load(std::memory_order_relaxed);
+		}
+
+		size_t getHardLimit() const noexcept
+		{
+			return hardLimit.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Add a callback that is called when the memory in use crosses the soft limit, and before an allocation
+		 * fails (see #setPressureRetries)
+		 *
+		 * @param callback the callback
+		 * @param user passed to the callback
+		 *
+		 * @return false if #TemAllocator::MaxPressureCallbacks callbacks were already added
+		 */
+		bool addPressureCallback(const PressureCallback callback, void *user = nullptr)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			if (pressureCallbackCount == MaxPressureCallbacks)
+			{
+				return false;
+			}
+			pressureCallbacks[pressureCallbackCount] = callback;
+			pressureUsers[pressureCallbackCount] = user;
+			++pressureCallbackCount;
+			return true;
+		}
+
+		/**
+		 * @brief Remove a callback that was added with the same user pointer
+		 *
+		 * @param callback the callback
+		 * @param user the user pointer
+		 */
+		void removePressureCallback(const PressureCallback callback, void *user = nullptr)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			for (size_t i = 0; i < pressureCallbackCount; ++i)
+			{
+				if (pressureCallbacks[i] == callback && pressureUsers[i] == user)
+				{
+					--pressureCallbackCount;
+					pressureCallbacks[i] = pressureCallbacks[pressureCallbackCount];
+					pressureUsers[i] = pressureUsers[pressureCallbackCount];
+					return;
+				}
+			}
+		}
+
+		/**
+		 * @brief Set how many times the pressure callbacks are called to free memory before an allocation that would go
+		 * over the hard limit, or that does not fit in the arena, fails. Zero (the default) fails right away.
+		 *
+		 * @param retries the number of retries
+		 */
+		void setPressureRetries(const size_t retries)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			pressureRetries = retries;
+		}
+
+		/**
+		 * @brief Set the handler that allocate and reallocate call before they throw #TemAllocator::bad_alloc. The
+		 * try_ functions of the allocators never call it.
+		 *
+		 * @param handler the handler or nullptr to throw right away
+		 * @param user passed to the handler
+		 */
+		void setOutOfMemoryHandler(const OutOfMemoryHandler handler, void *user = nullptr)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			outOfMemoryHandler = handler;
+			outOfMemoryUser = user;
+		}
+
+		/**
+		 * @brief Call the out of memory handler. Code that allocates from this data while holding its own lock must
+		 * use the try_ functions and call this after unlocking
+		 *
+		 * @param requested bytes that were requested
+		 *
+		 * @return true if the allocation should be tried again
+		 */
+		bool handleOutOfMemory(const size_t requested)
+		{
+			OutOfMemoryHandler handler;
+			void *user;
+			{
+				std::lock_guard<Mutex> g(mutex);
+				handler = outOfMemoryHandler;
+				user = outOfMemoryUser;
+			}
+			return handler != nullptr && handler(user, requested);
+		}
+
+		/**
+		 * @brief Take the lock before fork so the child does not get a copy of the data in the middle of a change. Must
+		 * be followed by #afterForkParent in the parent and #afterForkChild in the child (see pthread_atfork)
+		 */
+		void beforeFork()
+		{
+			mutex.lock();
+		}
+
+		void afterForkParent()
+		{
+			mutex.unlock();
+		}
+
+		/**
+		 * @brief Make a new lock in the child. The copied lock is owned by a thread that does not exist in the child
+		 */
+		void afterForkChild() noexcept
+		{
+			new (&mutex) Mutex();
+		}
+
+		/**
+		 * @brief Get the memory counted for an allocation tag (see #TemAllocator::ScopedTag)
+		 *
+		 * @param tag the tag
+		 *
+		 * @return the counters
+		 */
+		TagStats getTagStats(const size_t tag)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			return tagStats[tag & (MaxAllocationTags - 1)];
+		}
+
+		/**
+		 * @brief Get the placement policy
+		 *
+		 * @return the placement policy
+		 */
+		PlacementPolicy getPolicy() const noexcept
+		{
+			return placement.getPolicy();
+		}
+
+		/**
+		 * @brief Set how #TemAllocator::PlacementPolicy::Good searches. Only available when Policy is
+		 * #TemAllocator::GoodFit or #TemAllocator::RuntimePlacement
+		 *
+		 * @param slack A block at most this many bytes bigger than the request is taken right away
+		 * @param maxVisits Number of nodes visited before the best block so far is taken
+		 */
+		void setGoodFit(const size_t slack, const size_t maxVisits)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			GoodFit &good = placement.getGoodFit();
+			good.slack = slack;
+			good.maxVisits = maxVisits;
+		}
+
+		/**
+		 * @brief Get how #TemAllocator::PlacementPolicy::Good searches ended. Only available when Policy is
+		 * #TemAllocator::GoodFit or #TemAllocator::RuntimePlacement
+		 *
+		 * @return the counters
+		 */
+		GoodFitStats getGoodFitStats()
+		{
+			std::lock_guard<Mutex> g(mutex);
+			return placement.getGoodFit().stats;
+		}
+
+		/**
+		 * @brief Check if a pointer is inside of the memory managed by this data
+		 *
+		 * @param p the pointer
+		 *
+		 * @return true if the pointer is inside of the memory block
+		 */
+		bool owns(const void *p) const noexcept
+		{
+			const size_t address = reinterpret_cast<size_t>(p);
+			const size_t start = reinterpret_cast<size_t>(data);
+			return data != nullptr && address >= start && address < start + len;
+		}
 
 		/**
-		 * @brief Find a valid memory block
-		 *
-		 * @param size Requested memory block size
-		 * @param previousNode [out] the node before the foundNode
-		 * @param foundNode [out] the node that contains the request memory block
+		 * @brief Combine the blocks in the quick lists with their neighbors. Frees up memory for allocations of other
+		 * sizes. Also done when an allocation cannot be found and when the quick lists hold more than the threshold.
 		 */
-		void find(const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode)
+		void consolidate()
 		{
-			switch (policy)
-			{
-			case PlacementPolicy::First:
-				findFirst(size, previousNode, foundNode);
-				break;
-			case PlacementPolicy::Best:
-				findBest(size, previousNode, foundNode);
-				break;
-			default:
-				break;
-			}
+			std::lock_guard<Mutex> g(mutex);
+			consolidateQuickLists();
 		}
 
 		/**
-		 * @brief See #TemAllocator::PlacementPolicy::First
+		 * @brief Combine blocks from the quick lists with their neighbors until the quick lists hold at most a number of
+		 * bytes. Moves at most a number of blocks so the lock is only held for a short time. Larger blocks are moved
+		 * first.
 		 *
-		 * @param size Requested memory block size
-		 * @param previousNode [out] the node before the foundNode
-		 * @param foundNode [out] the node that contains the request memory block
+		 * @param targetBytes bytes the quick lists may keep
+		 * @param maxBlocks maximum number of blocks to move
+		 *
+		 * @return number of blocks moved
 		 */
-		void findFirst(const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode)
+		size_t consolidate(const size_t targetBytes, const size_t maxBlocks)
 		{
-			FreeListNode *it = list;
-			FreeListNode *prev = nullptr;
-			while (it != nullptr)
+			std::lock_guard<Mutex> g(mutex);
+			FreeListNode *blocks = nullptr;
+			size_t moved = 0;
+			for (size_t i = QuickListClasses; i-- > 0;)
 			{
-				if (it->blockSize >= size)
+				while (quickLists[i] != nullptr && moved < maxBlocks && quickListBytes > targetBytes)
 				{
-					break;
+					FreeListNode *node = quickLists[i];
+					quickLists[i] = node->next;
+					quickListBytes -= node->blockSize;
+					node->next = blocks;
+					blocks = node;
+					++moved;
 				}
-				prev = it;
-				it = it->next;
 			}
-			previousNode = prev;
-			foundNode = it;
+			insertFreeNodes(blocks);
+			return moved;
 		}
 
 		/**
-		 * @brief See #TemAllocator::PlacementPolicy::Best
+		 * @brief Set the number of bytes the quick lists can hold before they are consolidated. Zero combines every
+		 * freed block right away.
 		 *
-		 * @param size Requested memory block size
-		 * @param previousNode [out] the node before the foundNode
-		 * @param foundNode [out] the node that contains the request memory block
+		 * @param bytes the threshold
 		 */
-		void findBest(const size_t size, FreeListNode *&previousNode, FreeListNode *&foundNode)
+		void setQuickListThreshold(const size_t bytes)
 		{
-			size_t smallestDiff = std::numeric_limits<size_t>::max();
-			FreeListNode *bestBlock = nullptr;
-			FreeListNode *bestPrevBlock = nullptr;
-			FreeListNode *it = list;
-			FreeListNode *prev = nullptr;
-			while (it != nullptr)
+			std::lock_guard<Mutex> g(mutex);
+			quickListThreshold = bytes;
+			if (quickListBytes > quickListThreshold)
 			{
-				const size_t currentDiff = it->blockSize - size;
-				if (it->blockSize >= size && currentDiff < smallestDiff)
-				{
-					bestBlock = it;
-					bestPrevBlock = prev;
-					smallestDiff = currentDiff;
-				}
-				prev = it;
-				it = it->next;
+				consolidateQuickLists();
 			}
-			previousNode = bestPrevBlock;
-			foundNode = bestBlock;
-		}
-
-	public:
-		AllocatorData() noexcept
-			: mutex(), list(nullptr), data(nullptr), used(0), len(0),
-			  allocationNum(0), policy(PlacementPolicy::Best)
-		{
-		}
-		AllocatorData(const AllocatorData &) = delete;
-		AllocatorData(AllocatorData &&) = delete;
-
-		~AllocatorData()
-		{
-			close();
 		}
 
 		/**
-		 * @brief Get total availble memory
+		 * @brief Get the number of bytes in the quick lists
 		 *
-		 * @return total available memory in bytes
+		 * @return bytes in the quick lists
 		 */
-		size_t getTotal() const
+		size_t getQuickListBytes() const
 		{
-			return len;
+			return quickListBytes;
 		}
 
 		/**
-		 * @brief Get amount of memory currently in use
+		 * @brief Give the pages of the free block at the end of the heap back to the operating system. They read back
+		 * as zero. So, zeroed allocations from them are free until they are written to. Only works when the memory is
+		 * anonymous (see #init)
 		 *
-		 * @return memory in use in bytes
+		 * @return number of bytes given back
 		 */
-		size_t getUsed() const
+		size_t purge()
 		{
-			return used;
+#if __unix__
+			std::lock_guard<Mutex> g(mutex);
+			if (!purgeable || list == nullptr)
+			{
+				return 0;
+			}
+			FreeListNode *last = list;
+			while (last->next != nullptr)
+			{
+				last = last->next;
+			}
+			const size_t end = reinterpret_cast<size_t>(data) + len;
+			if (reinterpret_cast<size_t>(last) + last->blockSize != end)
+			{
+				return 0;
+			}
+			const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			const size_t start = (reinterpret_cast<size_t>(last) + sizeof(FreeListNode) + pageSize - 1) & ~(pageSize - 1);
+			const size_t purgeEnd = std::min((zeroStart + pageSize - 1) & ~(pageSize - 1), end & ~(pageSize - 1));
+			if (purgeEnd <= start || madvise(reinterpret_cast<void *>(start), purgeEnd - start, MADV_DONTNEED) != 0)
+			{
+				return 0;
+			}
+			// The end of the heap may not be page aligned. Clear what is left of the last page by hand.
+			if (zeroStart > purgeEnd)
+			{
+				memset(reinterpret_cast<void *>(purgeEnd), 0, zeroStart - purgeEnd);
+			}
+			zeroStart = start;
+			return purgeEnd - start;
+#else
+			return 0;
+#endif
 		}
 
 		/**
-		 * @brief Get number of allocation calls
+		 * Reset and re-allocate data. Does NOT re-assign pointers that were using the old memory block. Only use at startup
 		 *
-		 * @return Number of allocation calls
+		 * @param len Amount of total memory to use
+		 * @param policy Ignored when Policy is fixed at compile time
 		 */
-		size_t getNum() const
+		void init(const size_t len, PlacementPolicy policy = PlacementPolicy::Best)
 		{
-			return allocationNum;
+			close();
+
+			list = nullptr;
+			used = 0;
+			this->len = len;
+			// Large blocks come from fresh pages that are already zero. So, they are not cleared again
+			data = calloc(1, len);
+			ownsData = true;
+			placement.setPolicy(policy);
+			reset();
+			zeroStart = reinterpret_cast<size_t>(data) + sizeof(FreeListNode);
+			purgeable = true;
 		}
 
 		/**
-		 * Reset and re-allocate data. Does NOT re-assign pointers that were using the old memory block. Only use at startup
+		 * Reset and use memory owned by the caller. The memory is not freed when this data is closed. Only use at
+		 * startup
 		 *
-		 * @param len Amount of total memory to use
-		 * @param policy
+		 * @param buffer Memory to use. Must be aligned to #TemAllocator::MinimumAllocationSize
+		 * @param len Size of the buffer in bytes
+		 * @param policy Ignored when Policy is fixed at compile time
+		 * @param anonymous The buffer is fresh anonymous memory (i.e. from mmap). It is known to be zero and freed pages
+		 * read back as zero
 		 */
-		void init(const size_t len, PlacementPolicy policy = PlacementPolicy::Best)
+		void init(void *buffer, const size_t len, PlacementPolicy policy = PlacementPolicy::Best,
+				  const bool anonymous = false)
 		{
 			close();
 
 			list = nullptr;
 			used = 0;
 			this->len = len;
-			data = malloc(len);
-			this->policy = policy;
+			data = buffer;
+			ownsData = false;
+			placement.setPolicy(policy);
 			reset();
+			zeroStart = anonymous ? reinterpret_cast<size_t>(data) + sizeof(FreeListNode) : reinterpret_cast<size_t>(data) + len;
+			purgeable = anonymous;
 		}
 	};
 
-	constexpr size_t MinimumAllocationSize = 16;
-
 #if DEFINE_GLOBAL_ALLOCATOR
 	/**
 	 * Data used by default constructor of Allocators
@@ -274,30 +1452,87 @@ namespace TemAllocator
 	extern AllocatorData globalAllocatorData;
 #endif
 
+	/**
+	 * @brief Makes an arena the one used by default constructed allocators on the current thread until the scope ends.
+	 * Scopes can be nested.
+	 */
+	class ScopedArena
+	{
+	private:
+		AllocatorData *previous;
+
+		static AllocatorData *&slot() noexcept
+		{
+			static thread_local AllocatorData *arena = nullptr;
+			return arena;
+		}
+
+	public:
+		explicit ScopedArena(AllocatorData &ad) noexcept : previous(slot())
+		{
+			slot() = &ad;
+		}
+		ScopedArena(const ScopedArena &) = delete;
+		ScopedArena(ScopedArena &&) = delete;
+
+		~ScopedArena()
+		{
+			slot() = previous;
+		}
+
+		/**
+		 * @brief Get the arena of the innermost scope on this thread. If there is none, the global allocator data is
+		 * used when DEFINE_GLOBAL_ALLOCATOR is set.
+		 *
+		 * @return the arena or nullptr if there is none
+		 */
+		static AllocatorData *current() noexcept
+		{
+			AllocatorData *ad = slot();
+#if DEFINE_GLOBAL_ALLOCATOR
+			if (ad == nullptr)
+			{
+				return &globalAllocatorData;
+			}
+#endif
+			return ad;
+		}
+	};
+
 	/**
 	 * @brief Free list allocator
 	 *
 	 * @tparam T type to allocate
+	 * @tparam Data the data to allocate from (see #TemAllocator::BasicAllocatorData)
 	 */
-	template <class T>
+	template <class T, class Data>
 	class Allocator
 	{
 	public:
 		typedef T value_type;
 
-		template <class U>
+		// Allocators from different arenas are not interchangeable. A container moved or swapped takes its allocator
+		// with it so its memory is always freed into the arena it came from. Copies stay in the destination's arena.
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+		typedef std::false_type propagate_on_container_copy_assignment;
+		typedef std::false_type is_always_equal;
+
+		template <class U, class D>
 		friend class Allocator;
 
 	private:
-		AllocatorData &ad;
+		Data *ad;
 
 	public:
-#if DEFINE_GLOBAL_ALLOCATOR
-		Allocator() noexcept : ad(globalAllocatorData)
+		/**
+		 * @brief Use the arena from #TemAllocator::ScopedArena::current. Only available when Data is
+		 * #TemAllocator::AllocatorData
+		 */
+		Allocator() noexcept : ad(ScopedArena::current())
 		{
 		}
-#endif
-		Allocator(AllocatorData &ad) noexcept : ad(ad)
+		Allocator(Data &ad) noexcept : ad(&ad)
 		{
 		}
 		~Allocator()
@@ -305,22 +1540,34 @@ namespace TemAllocator
 		}
 
 		template <class U>
-		Allocator(const Allocator<U> &u) noexcept : ad(u.ad)
+		Allocator(const Allocator<U, Data> &u) noexcept : ad(u.ad)
 		{
 		}
 		template <class U>
-		bool operator==(const Allocator<U> &) const noexcept
+		bool operator==(const Allocator<U, Data> &u) const noexcept
 		{
-			return true;
+			return ad == u.ad;
 		}
 		template <class U>
-		bool operator!=(const Allocator<U> &) const noexcept
+		bool operator!=(const Allocator<U, Data> &u) const noexcept
+		{
+			return ad != u.ad;
+		}
+
+		/**
+		 * @brief Get the data this allocator allocates from
+		 *
+		 * @return the data
+		 */
+		Data &getData() const noexcept
 		{
-			return false;
+			return *ad;
 		}
 
 		/**
-		 * @brief Allocate a number of type T
+		 * @brief Allocate a number of type T. When there is not enough memory, the out of memory handler of the data
+		 * is called (see #TemAllocator::BasicAllocatorData::setOutOfMemoryHandler) and then #TemAllocator::bad_alloc
+		 * is thrown
 		 *
 		 * @param n Number of T's to allocate
 		 *
@@ -328,6 +1575,70 @@ namespace TemAllocator
 		 */
 		T *allocate(const size_t n = 1);
 
+		/**
+		 * @brief Allocate at least a number of type T. Blocks are rounded up, so there is often room for more T's than
+		 * requested. The caller may use all of them.
+		 *
+		 * @param n Minimum number of T's to allocate
+		 *
+		 * @return pointer to allocated data and the number of T's it can hold
+		 */
+		allocation_result<T *> allocate_at_least(const size_t n)
+		{
+			T *ptr = allocate(n);
+			if (ptr == nullptr)
+			{
+				return {ptr, 0};
+			}
+			// The block belongs to the caller now. So, its header can be read without the lock
+			const FreeListNode *node =
+				reinterpret_cast<const FreeListNode *>(reinterpret_cast<size_t>(ptr) - sizeof(FreeListNode));
+			return {ptr, (node->blockSize - sizeof(FreeListNode)) / sizeof(T)};
+		}
+
+		/**
+		 * @brief Get the number of T's that fit in the block an allocation of n T's gets. Growable containers can use
+		 * it as their capacity without another allocation
+		 *
+		 * @param n Number of T's
+		 *
+		 * @return number of T's the block can hold. At least n
+		 */
+		static constexpr size_t good_size(const size_t n)
+		{
+			return (std::max(sizeof(T) * n, MinimumAllocationSize) + MinimumAllocationSize -
+					std::max(sizeof(T) * n, MinimumAllocationSize) % MinimumAllocationSize) /
+				   sizeof(T);
+		}
+
+		/**
+		 * @brief Allocate a number of type T without throwing
+		 *
+		 * @param n Number of T's to allocate
+		 *
+		 * @return pointer to allocated data or nullptr if there is not enough memory
+		 */
+		T *try_allocate(const size_t n = 1) noexcept;
+
+		/**
+		 * @brief Allocate a number of type T that are set to zero. Only the part of the block that may have been written
+		 * to since the heap was created (or purged) is cleared
+		 *
+		 * @param n Number of T's to allocate
+		 *
+		 * @return pointer to allocated data
+		 */
+		T *allocate_zeroed(const size_t n = 1);
+
+		/**
+		 * @brief Allocate a number of type T that are set to zero without throwing. See #allocate_zeroed
+		 *
+		 * @param n Number of T's to allocate
+		 *
+		 * @return pointer to allocated data or nullptr if there is not enough memory
+		 */
+		T *try_allocate_zeroed(const size_t n = 1) noexcept;
+
 		/**
 		 * @brief Re-allocate a number of type T.
 		 *
@@ -341,11 +1652,21 @@ namespace TemAllocator
 		 */
 		T *reallocate(T *ptr, const size_t n);
 
+		/**
+		 * @brief Re-allocate a number of type T without throwing. See #reallocate
+		 *
+		 * @param ptr Pointer to the old data
+		 * @param n Number of T's to allocate
+		 *
+		 * @return pointer to allocated data or nullptr if there is not enough memory. The old data is not freed then
+		 */
+		T *try_reallocate(T *ptr, const size_t n) noexcept;
+
 		/**
 		 * @brief De-allocate the pointer
 		 *
 		 * @param p The pointer to free
-		 * @param count unused
+		 * @param count Number of T's that were allocated
 		 */
 		void deallocate(T *const p, const size_t count = 1);
 
@@ -402,8 +1723,63 @@ namespace TemAllocator
 		}
 	};
 
-	template <class T>
-	T *Allocator<T>::allocate(const size_t requestedCount)
+	/**
+	 * @brief Throw #TemAllocator::bad_alloc. Aborts when exceptions are disabled (i.e. -fno-exceptions)
+	 */
+	[[noreturn]] inline void throwBadAlloc()
+	{
+#if __cpp_exceptions
+		throw bad_alloc();
+#else
+		abort();
+#endif
+	}
+
+	template <class T, class Data>
+	T *Allocator<T, Data>::allocate(const size_t count)
+	{
+		T *ptr = try_allocate(count);
+		while (ptr == nullptr && count != 0)
+		{
+			if (ad == nullptr || !ad->handleOutOfMemory(sizeof(T) * count))
+			{
+				throwBadAlloc();
+			}
+			ptr = try_allocate(count);
+		}
+		return ptr;
+	}
+	template <class T, class Data>
+	T *Allocator<T, Data>::allocate_zeroed(const size_t count)
+	{
+		T *ptr = try_allocate_zeroed(count);
+		while (ptr == nullptr && count != 0)
+		{
+			if (ad == nullptr || !ad->handleOutOfMemory(sizeof(T) * count))
+			{
+				throwBadAlloc();
+			}
+			ptr = try_allocate_zeroed(count);
+		}
+		return ptr;
+	}
+	template <class T, class Data>
+	T *Allocator<T, Data>::reallocate(T *oldPtr, const size_t count)
+	{
+		T *ptr = try_reallocate(oldPtr, count);
+		while (ptr == nullptr && count != 0)
+		{
+			if (ad == nullptr || !ad->handleOutOfMemory(sizeof(T) * count))
+			{
+				throwBadAlloc();
+			}
+			ptr = try_reallocate(oldPtr, count);
+		}
+		return ptr;
+	}
+
+	template <class T, class Data>
+	T *Allocator<T, Data>::try_allocate(const size_t requestedCount) noexcept
 	{
 		// STL containers will call allocate with size 0. So, nullptr is valid
 		if (requestedCount == 0)
@@ -411,23 +1787,59 @@ namespace TemAllocator
 			return nullptr;
 		}
 
+		// Default constructed outside of any ScopedArena without a global allocator
+		if (ad == nullptr || requestedCount > std::numeric_limits<size_t>::max() / 2 / sizeof(T))
+		{
+			return nullptr;
+		}
+
 		const size_t requestedSize = sizeof(T) * requestedCount;
 
-		std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+		std::lock_guard<typename Data::Mutex> g(ad->mutex);
 
 		// Align memory just to be safe
 		size_t size = std::max(requestedSize, MinimumAllocationSize);
 		size += MinimumAllocationSize - (size % MinimumAllocationSize);
 		const size_t allocateSize = size + sizeof(FreeListNode);
 
+		if (!ad->checkLimits(allocateSize))
+		{
+			return nullptr;
+		}
+
+		// A block of the same size was freed recently. No need to search or split
+		FreeListNode *quickNode = ad->popQuickList(allocateSize);
+		if (quickNode != nullptr)
+		{
+			ad->used += quickNode->blockSize;
+			++ad->allocationNum;
+			ad->recordAllocation(quickNode);
+			return reinterpret_cast<T *>(reinterpret_cast<size_t>(quickNode) + sizeof(FreeListNode));
+		}
+
 		FreeListNode *affectedNode = nullptr;
 		FreeListNode *previousNode = nullptr;
-		ad.find(allocateSize, previousNode, affectedNode);
+		ad->find(allocateSize, previousNode, affectedNode);
+
+		// Blocks in the quick lists may be preventing blocks from being combined
+		if (affectedNode == nullptr)
+		{
+			ad->consolidateQuickLists();
+			ad->find(allocateSize, previousNode, affectedNode);
+		}
+
+		// Give the pressure callbacks a chance to free memory
+		for (size_t i = 0; affectedNode == nullptr && i < ad->pressureRetries; ++i)
+		{
+			ad->notifyPressure(allocateSize);
+			ad->consolidateQuickLists();
+			ad->find(allocateSize, previousNode, affectedNode);
+		}
 
 		// If null, then there is no block that can handle the requestedSize
 		if (affectedNode == nullptr)
 		{
-			throw bad_alloc();
+			return nullptr;
 		}
 
 		const size_t rest = affectedNode->blockSize - allocateSize;
@@ -440,31 +1852,61 @@ namespace TemAllocator
 				reinterpret_cast<FreeListNode *>(reinterpret_cast<size_t>(affectedNode) + allocateSize);
 			newFreeNode->blockSize = rest;
 			newFreeNode->next = nullptr;
-			FreeListNode::insert(ad.list, affectedNode, newFreeNode);
+			FreeListNode::insert(ad->list, affectedNode, newFreeNode);
 		}
 
+		ad->markDirty(reinterpret_cast<size_t>(affectedNode) + allocateSize + (rest > 0 ? sizeof(FreeListNode) : 0));
+
 		// Remove the allocated data from the linked list.
-		FreeListNode::remove(ad.list, previousNode, affectedNode);
+		ad->removeNode(previousNode, affectedNode);
 		affectedNode->blockSize = allocateSize;
 		affectedNode->next = nullptr;
 
-		ad.used += allocateSize;
+		ad->used += allocateSize;
+		ad->recordAllocation(affectedNode);
 
 		const size_t dataAddress = reinterpret_cast<size_t>(affectedNode) + sizeof(FreeListNode);
 		T *ptr = reinterpret_cast<T *>(dataAddress);
-		++ad.allocationNum;
+		++ad->allocationNum;
 		return ptr;
 	}
-	template <class T>
-	T *Allocator<T>::reallocate(T *oldPtr, const size_t count)
+	template <class T, class Data>
+	T *Allocator<T, Data>::try_allocate_zeroed(const size_t count) noexcept
 	{
-		std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+		if (ad == nullptr)
+		{
+			return nullptr;
+		}
+
+		std::lock_guard<typename Data::Mutex> g(ad->mutex);
 
+		const size_t zeroStart = ad->zeroStart;
+		T *ptr = try_allocate(count);
+		if (ptr != nullptr)
+		{
+			const size_t start = reinterpret_cast<size_t>(ptr);
+			const size_t end = std::min(start + sizeof(T) * count, zeroStart);
+			if (start < end)
+			{
+				memset(ptr, 0, end - start);
+			}
+		}
+		return ptr;
+	}
+	template <class T, class Data>
+	T *Allocator<T, Data>::try_reallocate(T *oldPtr, const size_t count) noexcept
+	{
 		if (oldPtr == nullptr)
 		{
-			return allocate(count);
+			return try_allocate(count);
+		}
+		if (count > std::numeric_limits<size_t>::max() / 2 / sizeof(T))
+		{
+			return nullptr;
 		}
 
+		std::lock_guard<typename Data::Mutex> g(ad->mutex);
+
 		// Align memory just to be safe
 		size_t size = sizeof(T) * count;
 		size = std::max<size_t>(size, MinimumAllocationSize);
@@ -484,11 +1926,16 @@ namespace TemAllocator
 			return oldPtr;
 		}
 
+		if (!ad->checkLimits(size - oldSize))
+		{
+			return nullptr;
+		}
+
 		{
 			// Find the block that would be right after the current block. That is the only block that can be used to
 			// extending the current block. Also, find the block before it in the linked list
 			const size_t target = nodeAddress + node->blockSize;
-			FreeListNode *it = ad.list;
+			FreeListNode *it = ad->list;
 			FreeListNode *prev = NULL;
 			while (it != NULL)
 			{
@@ -508,10 +1955,9 @@ namespace TemAllocator
 				// If the size of the two blocks is exactly the requested size, then just remove the block
 				if (combinedSize == newBlockSize)
 				{
-					ad.used -= node->blockSize;
-					ad.used += newBlockSize;
-					node->blockSize = newBlockSize;
-					FreeListNode::remove(ad.list, prev, it);
+					ad->resizeBlock(node, newBlockSize);
+					ad->removeNode(prev, it);
+					ad->markDirty(reinterpret_cast<size_t>(node) + newBlockSize);
 					return oldPtr;
 				}
 
@@ -519,14 +1965,13 @@ namespace TemAllocator
 				// remaining chunk can be inserted back into the list.
 				else if (newBlockSize < combinedSize)
 				{
-					ad.used -= node->blockSize;
-					ad.used += newBlockSize;
-					node->blockSize = newBlockSize;
+					ad->resizeBlock(node, newBlockSize);
 					FreeListNode *newNode = reinterpret_cast<FreeListNode *>(reinterpret_cast<size_t>(node) + newBlockSize);
 					newNode->blockSize = combinedSize - newBlockSize;
 					newNode->next = nullptr;
-					FreeListNode::remove(ad.list, prev, it);
-					FreeListNode::insert(ad.list, prev, newNode);
+					ad->removeNode(prev, it);
+					FreeListNode::insert(ad->list, prev, newNode);
+					ad->markDirty(reinterpret_cast<size_t>(newNode) + sizeof(FreeListNode));
 					return oldPtr;
 				}
 
@@ -537,56 +1982,47 @@ namespace TemAllocator
 
 		// At this point, it is determined that re-allocating is not possible.
 		// So, allocate new block, copy old block to new block, and free old block
-		T *newPtr = allocate(count);
+		T *newPtr = try_allocate(count);
+		if (newPtr == nullptr)
+		{
+			return nullptr;
+		}
 		memmove(newPtr, oldPtr, oldSize);
 		deallocate(oldPtr);
 		return newPtr;
 	}
-	template <class T>
-	void Allocator<T>::deallocate(T *const ptr, const size_t)
+	template <class T, class Data>
+	void Allocator<T, Data>::deallocate(T *const ptr, const size_t)
 	{
 		if (ptr == nullptr)
 		{
 			return;
 		}
 
-		std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+		std::lock_guard<typename Data::Mutex> g(ad->mutex);
 
 		const size_t currentAddress = reinterpret_cast<size_t>(ptr);
 		const size_t headerAddress = currentAddress - sizeof(FreeListNode);
 
 		FreeListNode *freeNode = reinterpret_cast<FreeListNode *>(headerAddress);
-		freeNode->next = nullptr;
-
-		FreeListNode *it = ad.list;
-		FreeListNode *prev = nullptr;
-
-		// Insert the block back into the list at the right spot
-		while (it != nullptr)
+		ad->recordDeallocation(freeNode);
+		ad->used -= freeNode->blockSize;
+		--ad->allocationNum;
+		if (ad->underPressure && ad->used <= ad->softLimit.load(std::memory_order_relaxed))
 		{
-			if (freeNode < it)
-			{
-				FreeListNode::insert(ad.list, prev, freeNode);
-				break;
-			}
-			prev = it;
-			it = it->next;
+			ad->underPressure = false;
 		}
 
-		ad.used -= freeNode->blockSize;
-
-		// Combine adjacent blocks into one
-		ad.coalescence(prev, freeNode);
-		--ad.allocationNum;
+		ad->freeBlock(freeNode);
 	}
-	template <class T>
-	size_t Allocator<T>::getBlockSize(const T *const ptr) const
+	template <class T, class Data>
+	size_t Allocator<T, Data>::getBlockSize(const T *const ptr) const
 	{
 		if (ptr == nullptr)
 		{
 			return 0;
 		}
-		std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+		std::lock_guard<typename Data::Mutex> g(ad->mutex);
 
 		const size_t currentAddress = reinterpret_cast<size_t>(ptr);
 		const size_t headerAddress = currentAddress - sizeof(FreeListNode);
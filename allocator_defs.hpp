@@ -15,6 +15,7 @@
 #pragma once
 
 #include "allocator.hpp"
+#include "vector.hpp"
 
 #include <string>
 #include <locale>
@@ -27,6 +28,7 @@
 #include <set>
 #include <list>
 #include <cmath>
+#include <cstdint>
 #include <deque>
 #include <queue>
 
@@ -66,6 +68,253 @@ namespace TemAllocator
 	template <typename T>
 	using Stack = std::stack<T, Deque<T>>;
 
+	/**
+	 * @brief Container with stable keys and contiguous storage. Insert, erase and lookup are O(1) and iterating only
+	 * visits live elements.
+	 *
+	 * A key holds a slot index (low 32 bits) and the slot's generation (high 32 bits). A generation is odd while the
+	 * slot is in use and is incremented when it is erased. So, keys of erased elements are detected.
+	 *
+	 * @tparam T type to store
+	 */
+	template <typename T>
+	class SlotMap
+	{
+	public:
+		using Key = uint64_t;
+		using iterator = typename List<T>::iterator;
+		using const_iterator = typename List<T>::const_iterator;
+
+		/**
+		 * @brief No element ever has this key
+		 */
+		static constexpr Key NullKey = 0;
+
+	private:
+		struct Slot
+		{
+			// Position in values while in use. Next free slot otherwise
+			uint32_t index;
+			uint32_t generation;
+		};
+
+		static constexpr uint32_t NoSlot = std::numeric_limits<uint32_t>::max();
+
+		List<T> values;
+		List<uint32_t> valueSlots;
+		List<Slot> slots;
+		uint32_t freeSlot;
+
+		static Key makeKey(const uint32_t slot, const uint32_t generation) noexcept
+		{
+			return (static_cast<Key>(generation) << 32) | slot;
+		}
+
+		const Slot *findSlot(const Key key) const noexcept
+		{
+			const uint32_t slot = static_cast<uint32_t>(key);
+			const uint32_t generation = static_cast<uint32_t>(key >> 32);
+			if (slot >= slots.size() || (generation & 1) == 0 || slots[slot].generation != generation)
+			{
+				return nullptr;
+			}
+			return &slots[slot];
+		}
+
+	public:
+		explicit SlotMap(const Allocator<T> &a = Allocator<T>())
+			: values(a), valueSlots(Allocator<uint32_t>(a)), slots(Allocator<Slot>(a)), freeSlot(NoSlot)
+		{
+		}
+
+		size_t size() const noexcept
+		{
+			return values.size();
+		}
+
+		bool empty() const noexcept
+		{
+			return values.empty();
+		}
+
+		void reserve(const size_t n)
+		{
+			values.reserve(n);
+			valueSlots.reserve(n);
+			slots.reserve(n);
+		}
+
+		/**
+		 * @brief Construct an element in place
+		 *
+		 * @return key of the new element
+		 */
+		template <typename... Args>
+		Key emplace(Args &&...args)
+		{
+			uint32_t slot = freeSlot;
+			if (slot == NoSlot)
+			{
+				slot = static_cast<uint32_t>(slots.size());
+				slots.push_back(Slot{NoSlot, 0});
+			}
+			valueSlots.reserve(values.size() + 1);
+			values.emplace_back(std::forward<Args>(args)...);
+			valueSlots.push_back(slot);
+
+			Slot &s = slots[slot];
+			if (slot == freeSlot)
+			{
+				freeSlot = s.index;
+			}
+			s.index = static_cast<uint32_t>(values.size() - 1);
+			++s.generation;
+			return makeKey(slot, s.generation);
+		}
+
+		Key insert(const T &t)
+		{
+			return emplace(t);
+		}
+
+		Key insert(T &&t)
+		{
+			return emplace(std::move(t));
+		}
+
+		/**
+		 * @brief Remove an element. The last element is moved into its place
+		 *
+		 * @param key the key
+		 *
+		 * @return true if the key was valid
+		 */
+		bool erase(const Key key)
+		{
+			const Slot *found = findSlot(key);
+			if (found == nullptr)
+			{
+				return false;
+			}
+			const uint32_t slot = static_cast<uint32_t>(key);
+			const uint32_t index = found->index;
+			const size_t last = values.size() - 1;
+			if (index != last)
+			{
+				values[index] = std::move(values[last]);
+				valueSlots[index] = valueSlots[last];
+				slots[valueSlots[index]].index = index;
+			}
+			values.pop_back();
+			valueSlots.pop_back();
+
+			Slot &s = slots[slot];
+			++s.generation;
+			s.index = freeSlot;
+			freeSlot = slot;
+			return true;
+		}
+
+		bool contains(const Key key) const noexcept
+		{
+			return findSlot(key) != nullptr;
+		}
+
+		/**
+		 * @brief Get an element
+		 *
+		 * @param key the key
+		 *
+		 * @return the element or nullptr if the key is not valid
+		 */
+		T *get(const Key key) noexcept
+		{
+			const Slot *s = findSlot(key);
+			return s == nullptr ? nullptr : &values[s->index];
+		}
+
+		const T *get(const Key key) const noexcept
+		{
+			const Slot *s = findSlot(key);
+			return s == nullptr ? nullptr : &values[s->index];
+		}
+
+		/**
+		 * @brief Get the key of the element at a position in the contiguous storage
+		 *
+		 * @param index position of the element
+		 *
+		 * @return the key
+		 */
+		Key keyAt(const size_t index) const noexcept
+		{
+			const uint32_t slot = valueSlots[index];
+			return makeKey(slot, slots[slot].generation);
+		}
+
+		void clear()
+		{
+			for (size_t i = 0; i < valueSlots.size(); ++i)
+			{
+				Slot &s = slots[valueSlots[i]];
+				++s.generation;
+				s.index = freeSlot;
+				freeSlot = valueSlots[i];
+			}
+			values.clear();
+			valueSlots.clear();
+		}
+
+		T *data() noexcept
+		{
+			return values.data();
+		}
+
+		const T *data() const noexcept
+		{
+			return values.data();
+		}
+
+		iterator begin() noexcept
+		{
+			return values.begin();
+		}
+
+		iterator end() noexcept
+		{
+			return values.end();
+		}
+
+		const_iterator begin() const noexcept
+		{
+			return values.begin();
+		}
+
+		const_iterator end() const noexcept
+		{
+			return values.end();
+		}
+	};
+
+	/**
+	 * @brief Move a container into another arena.
+	 *
+	 * If the container already uses the arena, its memory is taken without copying. Otherwise, each element is moved
+	 * into memory from the new arena and the old memory is freed into the arena it came from.
+	 *
+	 * @tparam C the container type
+	 * @tparam Data the arena type (i.e. AllocatorData or LinearAllocatorData)
+	 * @param c the container to move
+	 * @param data the arena to move to
+	 *
+	 * @return the container using the new arena
+	 */
+	template <typename C, typename Data>
+	static inline C moveToArena(C &&c, Data &data)
+	{
+		return C(std::move(c), typename C::allocator_type(data));
+	}
+
 	template <typename T, typename... Args>
 	static inline T *allocateAndConstruct(Args &&...args)
 	{
@@ -83,39 +332,73 @@ namespace TemAllocator
 		a.deallocate(t);
 	}
 
+	template <typename T>
+	static inline void destroyAndDeallocate(T *const t, AllocatorData &ad)
+	{
+		Allocator<T> a(ad);
+		a.destroy(t);
+		a.deallocate(t);
+	}
+
+	/**
+	 * @brief Deleter that frees into the arena that was current when it was created. So, a pointer made inside of a
+	 * #TemAllocator::ScopedArena can outlive the scope.
+	 */
 	template <typename T>
 	struct Deleter
 	{
-		constexpr Deleter() noexcept = default;
+		template <typename U>
+		friend struct Deleter;
+
+	private:
+		AllocatorData *ad;
+
+	public:
+		Deleter() noexcept : ad(ScopedArena::current())
+		{
+		}
+		explicit Deleter(AllocatorData &ad) noexcept : ad(&ad)
+		{
+		}
 #if __unix__ && !__EMSCRIPTEN__
 		template <typename U, typename = std::_Require<std::is_convertible<U *, T *>>>
-		constexpr Deleter(Deleter<U>) noexcept
+		Deleter(Deleter<U> u) noexcept : ad(u.ad)
 		{
 		}
 #else
 		template <typename U>
-		constexpr Deleter(Deleter<U>) noexcept
+		Deleter(Deleter<U> u) noexcept : ad(u.ad)
 		{
 		}
 #endif
 
-		constexpr bool operator==(const Deleter &) const noexcept
+		bool operator==(const Deleter &d) const noexcept
 		{
-			return true;
+			return ad == d.ad;
 		}
 
-		constexpr bool operator!=(const Deleter &) const noexcept
+		bool operator!=(const Deleter &d) const noexcept
 		{
-			return false;
+			return ad != d.ad;
 		}
 
+		/**
+		 * @brief Destroy and free an object. A deleter made outside of every #TemAllocator::ScopedArena frees into the
+		 * arena that is current now. Aborts if that arena does not own the object since freeing it there would corrupt
+		 * both heaps
+		 */
 		void operator()(T *t) const
 		{
 			if (t == nullptr)
 			{
 				return;
 			}
-			destroyAndDeallocate(t);
+			AllocatorData *const data = ad != nullptr ? ad : ScopedArena::current();
+			if (data == nullptr || !data->owns(t))
+			{
+				abort();
+			}
+			destroyAndDeallocate(t, *data);
 		}
 	};
 
@@ -0,0 +1,410 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "engine_allocator.hpp"
+
+#include <cstdint>
+
+#if __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace TemAllocator
+{
+	constexpr size_t BitmapGranuleSize = MinimumAllocationSize;
+
+	/**
+	 * @brief Allocator engine that tracks the heap as a bitmap of fixed size granules. No metadata is stored in the
+	 * blocks. A second bitmap marks the last granule of every block so its size can be found when it is freed.
+	 *
+	 * Free runs are found by scanning 64 granules per word with count trailing zeros. Full words are skipped without
+	 * looking at single bits.
+	 */
+	class BitmapAllocatorData
+	{
+	private:
+		using Mutex = std::mutex;
+		Mutex mutex;
+		uint8_t *data;
+		// 1 for each granule in use
+		uint64_t *usedMap;
+		// 1 for the last granule of each block
+		uint64_t *endMap;
+		size_t granules;
+		size_t words;
+		// No free granule comes before this one
+		size_t searchStart;
+		size_t used;
+		size_t allocationNum;
+		bool ownsData;
+
+		static size_t countTrailingZeros(const uint64_t x) noexcept
+		{
+			return static_cast<size_t>(__builtin_ctzll(x));
+		}
+
+		/**
+		 * @brief Find the first bit that is 0 in a bitmap
+		 *
+		 * @param map the bitmap
+		 * @param i first bit to look at
+		 *
+		 * @return index of the bit or granules if there is none
+		 */
+		size_t findZero(const uint64_t *map, size_t i) const noexcept
+		{
+			size_t w = i / 64;
+			if (w >= words)
+			{
+				return granules;
+			}
+			uint64_t bits = ~map[w] & (~uint64_t(0) << (i % 64));
+			while (bits == 0)
+			{
+				++w;
+#if __AVX2__
+				// Skip four full words at a time
+				while (w + 4 <= words)
+				{
+					const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(map + w));
+					if (!_mm256_testc_si256(v, _mm256_set1_epi64x(-1)))
+					{
+						break;
+					}
+					w += 4;
+				}
+#endif
+				if (w >= words)
+				{
+					return granules;
+				}
+				bits = ~map[w];
+			}
+			return std::min(w * 64 + countTrailingZeros(bits), granules);
+		}
+
+		/**
+		 * @brief Find the first bit that is 1 in a bitmap
+		 *
+		 * @param map the bitmap
+		 * @param i first bit to look at
+		 * @param limit stop looking at this bit
+		 *
+		 * @return index of the bit or limit if there is none
+		 */
+		size_t findOne(const uint64_t *map, size_t i, const size_t limit) const noexcept
+		{
+			if (i >= limit)
+			{
+				return limit;
+			}
+			size_t w = i / 64;
+			const size_t lastWord = (limit - 1) / 64;
+			uint64_t bits = map[w] & (~uint64_t(0) << (i % 64));
+			while (bits == 0)
+			{
+				++w;
+#if __AVX2__
+				// Skip four empty words at a time
+				while (w + 4 <= lastWord + 1)
+				{
+					const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(map + w));
+					if (!_mm256_testz_si256(v, v))
+					{
+						break;
+					}
+					w += 4;
+				}
+#endif
+				if (w > lastWord)
+				{
+					return limit;
+				}
+				bits = map[w];
+			}
+			return std::min(w * 64 + countTrailingZeros(bits), limit);
+		}
+
+		static void setBit(uint64_t *map, const size_t i) noexcept
+		{
+			map[i / 64] |= uint64_t(1) << (i % 64);
+		}
+
+		static void clearBit(uint64_t *map, const size_t i) noexcept
+		{
+			map[i / 64] &= ~(uint64_t(1) << (i % 64));
+		}
+
+		/**
+		 * @brief Set or clear a range of bits one word at a time
+		 */
+		static void setRange(uint64_t *map, size_t start, const size_t end, const bool value) noexcept
+		{
+			while (start < end)
+			{
+				const size_t bit = start % 64;
+				const size_t count = std::min<size_t>(64 - bit, end - start);
+				const uint64_t mask = count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1) << bit;
+				if (value)
+				{
+					map[start / 64] |= mask;
+				}
+				else
+				{
+					map[start / 64] &= ~mask;
+				}
+				start += count;
+			}
+		}
+
+		static size_t toGranules(const size_t bytes) noexcept
+		{
+			return (std::max<size_t>(bytes, 1) + BitmapGranuleSize - 1) / BitmapGranuleSize;
+		}
+
+		size_t getGranule(const void *p) const noexcept
+		{
+			return (reinterpret_cast<size_t>(p) - reinterpret_cast<size_t>(data)) / BitmapGranuleSize;
+		}
+
+		/**
+		 * @brief Get the number of granules of the block starting at a granule
+		 */
+		size_t getBlockGranules(const size_t start) const noexcept
+		{
+			return findOne(endMap, start, granules) - start + 1;
+		}
+
+		void mark(const size_t start, const size_t count) noexcept
+		{
+			setRange(usedMap, start, start + count, true);
+			setBit(endMap, start + count - 1);
+		}
+
+		void *allocateLocked(const size_t bytes)
+		{
+			if (bytes > getTotal())
+			{
+				throwBadAlloc();
+			}
+			const size_t count = toGranules(bytes);
+			size_t start = findZero(usedMap, searchStart);
+			const size_t firstFree = start;
+			while (start + count <= granules)
+			{
+				const size_t end = findOne(usedMap, start, start + count);
+				if (end == start + count)
+				{
+					mark(start, count);
+					if (start == firstFree)
+					{
+						searchStart = start + count;
+					}
+					used += count * BitmapGranuleSize;
+					++allocationNum;
+					return data + start * BitmapGranuleSize;
+				}
+				start = findZero(usedMap, end);
+			}
+			searchStart = firstFree;
+			throwBadAlloc();
+		}
+
+		void deallocateLocked(void *ptr) noexcept
+		{
+			const size_t start = getGranule(ptr);
+			const size_t count = getBlockGranules(start);
+			setRange(usedMap, start, start + count, false);
+			clearBit(endMap, start + count - 1);
+			searchStart = std::min(searchStart, start);
+			used -= count * BitmapGranuleSize;
+			--allocationNum;
+		}
+
+		void close()
+		{
+			if (data != nullptr && ownsData)
+			{
+				free(data);
+			}
+			free(usedMap);
+			free(endMap);
+			data = nullptr;
+			usedMap = nullptr;
+			endMap = nullptr;
+			ownsData = false;
+		}
+
+		void reset(const size_t len)
+		{
+			granules = len / BitmapGranuleSize;
+			words = (granules + 63) / 64;
+			usedMap = static_cast<uint64_t *>(calloc(words, sizeof(uint64_t)));
+			endMap = static_cast<uint64_t *>(calloc(words, sizeof(uint64_t)));
+			if (usedMap == nullptr || endMap == nullptr)
+			{
+				close();
+				throwBadAlloc();
+			}
+			// Granules after the end of the heap are always in use
+			setRange(usedMap, granules, words * 64, true);
+			searchStart = 0;
+			used = 0;
+			allocationNum = 0;
+		}
+
+	public:
+		BitmapAllocatorData() noexcept
+			: mutex(), data(nullptr), usedMap(nullptr), endMap(nullptr), granules(0), words(0), searchStart(0),
+			  used(0), allocationNum(0), ownsData(false)
+		{
+		}
+		BitmapAllocatorData(const BitmapAllocatorData &) = delete;
+		BitmapAllocatorData(BitmapAllocatorData &&) = delete;
+
+		~BitmapAllocatorData()
+		{
+			close();
+		}
+
+		size_t getTotal() const
+		{
+			return granules * BitmapGranuleSize;
+		}
+
+		size_t getUsed() const
+		{
+			return used;
+		}
+
+		size_t getNum() const
+		{
+			return allocationNum;
+		}
+
+		/**
+		 * Reset and re-allocate data. Does NOT re-assign pointers that were using the old memory block. Only use at startup
+		 *
+		 * @param len Amount of total memory to use
+		 */
+		void init(const size_t len)
+		{
+			close();
+			data = static_cast<uint8_t *>(malloc(len));
+			if (data == nullptr)
+			{
+				throwBadAlloc();
+			}
+			ownsData = true;
+			reset(len);
+		}
+
+		/**
+		 * Reset and use memory owned by the caller. Only use at startup
+		 *
+		 * @param buffer Memory to use. Must be aligned to #TemAllocator::BitmapGranuleSize
+		 * @param len Size of the buffer in bytes
+		 */
+		void init(void *buffer, const size_t len)
+		{
+			close();
+			data = static_cast<uint8_t *>(buffer);
+			reset(len);
+		}
+
+		void *allocate(const size_t bytes)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			return allocateLocked(bytes);
+		}
+
+		/**
+		 * @brief Resize a block. Shrinks in place and grows in place when the granules after the block are free
+		 *
+		 * @param ptr the block
+		 * @param bytes the new size
+		 *
+		 * @return the block
+		 */
+		void *reallocate(void *ptr, const size_t bytes)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			if (ptr == nullptr)
+			{
+				return allocateLocked(bytes);
+			}
+
+			if (bytes > getTotal())
+			{
+				throwBadAlloc();
+			}
+
+			const size_t start = getGranule(ptr);
+			const size_t oldCount = getBlockGranules(start);
+			const size_t count = toGranules(bytes);
+			if (count <= oldCount)
+			{
+				if (count < oldCount)
+				{
+					clearBit(endMap, start + oldCount - 1);
+					setRange(usedMap, start + count, start + oldCount, false);
+					setBit(endMap, start + count - 1);
+					searchStart = std::min(searchStart, start + count);
+					used -= (oldCount - count) * BitmapGranuleSize;
+				}
+				return ptr;
+			}
+
+			const size_t end = start + count;
+			if (end <= granules && findOne(usedMap, start + oldCount, end) == end)
+			{
+				clearBit(endMap, start + oldCount - 1);
+				mark(start + oldCount, count - oldCount);
+				used += (count - oldCount) * BitmapGranuleSize;
+				return ptr;
+			}
+
+			void *newPtr = allocateLocked(bytes);
+			memcpy(newPtr, ptr, oldCount * BitmapGranuleSize);
+			deallocateLocked(ptr);
+			return newPtr;
+		}
+
+		void deallocate(void *ptr)
+		{
+			if (ptr == nullptr)
+			{
+				return;
+			}
+			std::lock_guard<Mutex> g(mutex);
+			deallocateLocked(ptr);
+		}
+
+		size_t getBlockSize(const void *ptr)
+		{
+			if (ptr == nullptr)
+			{
+				return 0;
+			}
+			std::lock_guard<Mutex> g(mutex);
+			return getBlockGranules(getGranule(ptr)) * BitmapGranuleSize;
+		}
+	};
+
+	template <class T>
+	using BitmapAllocator = EngineAllocator<T, BitmapAllocatorData>;
+} // namespace TemAllocator
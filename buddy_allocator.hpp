@@ -0,0 +1,448 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "engine_allocator.hpp"
+
+#include <cstdint>
+
+namespace TemAllocator
+{
+	constexpr size_t BuddyMinimumBlockShift = 5;
+	constexpr size_t BuddyMinimumBlockSize = size_t(1) << BuddyMinimumBlockShift;
+	static_assert(BuddyMinimumBlockSize >= 2 * MinimumAllocationSize, "Buddy blocks must fit a header and a free block");
+
+	/**
+	 * @brief How a buddy allocator serves sizes that are not a power of two
+	 */
+	enum class BuddyMode
+	{
+		PowerOfTwo, ///< Round up to the next power of two. The faster mode.
+		Exact
+		///< Round up to the minimum block size and give the unused tail of the power of two block back as smaller
+		///< buddies. Wastes less memory. Freeing costs one merge per set bit of the block size
+	};
+
+	/**
+	 * @brief Binary buddy allocator engine. Blocks are powers of two of #TemAllocator::BuddyMinimumBlockSize. Each
+	 * order has a free list and a bitmap of the blocks of that order that are free. So, allocating and freeing take
+	 * O(log n) and merging with a buddy only tests one bit.
+	 */
+	class BuddyAllocatorData
+	{
+	private:
+		/**
+		 * Free blocks are linked in both directions so a buddy can be removed from the middle of its list
+		 */
+		struct FreeBlock
+		{
+			FreeBlock *previous;
+			FreeBlock *next;
+		};
+
+		/**
+		 * Stored at the start of every allocated block
+		 */
+		struct BlockHeader
+		{
+			size_t units;
+			size_t unused;
+		};
+
+		static constexpr size_t MaxOrders = 64;
+
+		using Mutex = std::mutex;
+		Mutex mutex;
+		uint8_t *data;
+		size_t len;
+		size_t orders;
+		FreeBlock *freeLists[MaxOrders];
+		// Start of each order's bits in freeMap
+		size_t freeMapOffsets[MaxOrders];
+		uint64_t *freeMap;
+		size_t used;
+		size_t allocationNum;
+		BuddyMode mode;
+		AllocatorData *parent;
+		bool ownsData;
+
+		static size_t getBlockSize(const size_t order) noexcept
+		{
+			return BuddyMinimumBlockSize << order;
+		}
+
+		static size_t getOrder(const size_t units) noexcept
+		{
+			size_t order = 0;
+			while ((size_t(1) << order) < units)
+			{
+				++order;
+			}
+			return order;
+		}
+
+		size_t getBit(const size_t offset, const size_t order) const noexcept
+		{
+			return freeMapOffsets[order] + (offset >> (order + BuddyMinimumBlockShift));
+		}
+
+		bool isFree(const size_t offset, const size_t order) const noexcept
+		{
+			const size_t bit = getBit(offset, order);
+			return (freeMap[bit / 64] >> (bit % 64)) & 1;
+		}
+
+		void setFree(const size_t offset, const size_t order, const bool value) noexcept
+		{
+			const size_t bit = getBit(offset, order);
+			if (value)
+			{
+				freeMap[bit / 64] |= uint64_t(1) << (bit % 64);
+			}
+			else
+			{
+				freeMap[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+			}
+		}
+
+		void push(const size_t offset, const size_t order) noexcept
+		{
+			FreeBlock *block = reinterpret_cast<FreeBlock *>(data + offset);
+			block->previous = nullptr;
+			block->next = freeLists[order];
+			if (block->next != nullptr)
+			{
+				block->next->previous = block;
+			}
+			freeLists[order] = block;
+			setFree(offset, order, true);
+		}
+
+		void unlink(const size_t offset, const size_t order) noexcept
+		{
+			FreeBlock *block = reinterpret_cast<FreeBlock *>(data + offset);
+			if (block->previous == nullptr)
+			{
+				freeLists[order] = block->next;
+			}
+			else
+			{
+				block->previous->next = block->next;
+			}
+			if (block->next != nullptr)
+			{
+				block->next->previous = block->previous;
+			}
+			setFree(offset, order, false);
+		}
+
+		/**
+		 * @brief Free a block and merge it with its buddy as long as the buddy is free
+		 */
+		void release(size_t offset, size_t order) noexcept
+		{
+			while (order + 1 < orders)
+			{
+				const size_t size = getBlockSize(order);
+				const size_t buddy = offset ^ size;
+				if (std::min(offset, buddy) + 2 * size > len || !isFree(buddy, order))
+				{
+					break;
+				}
+				unlink(buddy, order);
+				offset = std::min(offset, buddy);
+				++order;
+			}
+			push(offset, order);
+		}
+
+		void *allocateLocked(const size_t bytes)
+		{
+			if (bytes > len)
+			{
+				throwBadAlloc();
+			}
+			size_t units =
+				(std::max<size_t>(bytes, 1) + sizeof(BlockHeader) + BuddyMinimumBlockSize - 1) / BuddyMinimumBlockSize;
+			const size_t order = getOrder(units);
+
+			size_t found = order;
+			while (found < orders && freeLists[found] == nullptr)
+			{
+				++found;
+			}
+			if (found >= orders)
+			{
+				throwBadAlloc();
+			}
+
+			size_t offset = static_cast<size_t>(reinterpret_cast<uint8_t *>(freeLists[found]) - data);
+			unlink(offset, found);
+
+			// Split until the block has the requested order
+			while (found > order)
+			{
+				--found;
+				push(offset + getBlockSize(found), found);
+			}
+
+			if (mode == BuddyMode::PowerOfTwo)
+			{
+				units = size_t(1) << order;
+			}
+			else
+			{
+				// Keep the first units of the block and free the rest as smaller buddies
+				size_t start = offset;
+				size_t remaining = units;
+				size_t o = order;
+				while (remaining < (size_t(1) << o))
+				{
+					--o;
+					const size_t half = size_t(1) << o;
+					if (remaining <= half)
+					{
+						push(start + getBlockSize(o), o);
+					}
+					else
+					{
+						remaining -= half;
+						start += getBlockSize(o);
+					}
+				}
+			}
+
+			BlockHeader *header = reinterpret_cast<BlockHeader *>(data + offset);
+			header->units = units;
+			used += units * BuddyMinimumBlockSize;
+			++allocationNum;
+			return data + offset + sizeof(BlockHeader);
+		}
+
+		void deallocateLocked(void *ptr) noexcept
+		{
+			uint8_t *block = static_cast<uint8_t *>(ptr) - sizeof(BlockHeader);
+			size_t offset = static_cast<size_t>(block - data);
+			const size_t units = reinterpret_cast<const BlockHeader *>(block)->units;
+			used -= units * BuddyMinimumBlockSize;
+			--allocationNum;
+
+			// A block is one buddy per set bit of its size. Largest first.
+			for (size_t o = orders; o-- > 0;)
+			{
+				if (units & (size_t(1) << o))
+				{
+					release(offset, o);
+					offset += getBlockSize(o);
+				}
+			}
+		}
+
+		void close()
+		{
+			if (data != nullptr)
+			{
+				if (parent != nullptr)
+				{
+					Allocator<uint8_t>(*parent).deallocate(data);
+				}
+				else if (ownsData)
+				{
+					free(data);
+				}
+			}
+			free(freeMap);
+			data = nullptr;
+			freeMap = nullptr;
+			parent = nullptr;
+			ownsData = false;
+			len = 0;
+			orders = 0;
+		}
+
+		void reset(const size_t len, const BuddyMode mode)
+		{
+			this->mode = mode;
+			this->len = len - (len % BuddyMinimumBlockSize);
+			orders = 1;
+			while (orders < MaxOrders && getBlockSize(orders) <= this->len)
+			{
+				++orders;
+			}
+
+			size_t bits = 0;
+			for (size_t i = 0; i < orders; ++i)
+			{
+				freeMapOffsets[i] = bits;
+				bits += (this->len >> (i + BuddyMinimumBlockShift)) + 1;
+				freeLists[i] = nullptr;
+			}
+			freeMap = static_cast<uint64_t *>(calloc((bits + 63) / 64, sizeof(uint64_t)));
+			if (freeMap == nullptr)
+			{
+				close();
+				throwBadAlloc();
+			}
+
+			// Cover the memory with the largest aligned blocks that fit
+			size_t offset = 0;
+			for (size_t o = orders; o-- > 0;)
+			{
+				if (offset + getBlockSize(o) <= this->len)
+				{
+					push(offset, o);
+					offset += getBlockSize(o);
+				}
+			}
+			used = 0;
+			allocationNum = 0;
+		}
+
+	public:
+		BuddyAllocatorData() noexcept
+			: mutex(), data(nullptr), len(0), orders(0), freeLists(), freeMapOffsets(), freeMap(nullptr), used(0),
+			  allocationNum(0), mode(BuddyMode::PowerOfTwo), parent(nullptr), ownsData(false)
+		{
+		}
+		BuddyAllocatorData(const BuddyAllocatorData &) = delete;
+		BuddyAllocatorData(BuddyAllocatorData &&) = delete;
+
+		~BuddyAllocatorData()
+		{
+			close();
+		}
+
+		size_t getTotal() const
+		{
+			return len;
+		}
+
+		size_t getUsed() const
+		{
+			return used;
+		}
+
+		size_t getNum() const
+		{
+			return allocationNum;
+		}
+
+		/**
+		 * Reset and re-allocate data. Does NOT re-assign pointers that were using the old memory block. Only use at startup
+		 *
+		 * @param len Amount of total memory to use
+		 * @param mode
+		 */
+		void init(const size_t len, const BuddyMode mode = BuddyMode::PowerOfTwo)
+		{
+			close();
+			data = static_cast<uint8_t *>(malloc(len));
+			if (data == nullptr)
+			{
+				throwBadAlloc();
+			}
+			ownsData = true;
+			reset(len, mode);
+		}
+
+		/**
+		 * Reset and take the memory from a free list allocator. The memory is returned to it when this data is closed.
+		 * Only use at startup
+		 *
+		 * @param parent the free list allocator's data
+		 * @param len Amount of total memory to use
+		 * @param mode
+		 */
+		void init(AllocatorData &parent, const size_t len, const BuddyMode mode = BuddyMode::PowerOfTwo)
+		{
+			close();
+			data = Allocator<uint8_t>(parent).allocate(len);
+			this->parent = &parent;
+			reset(len, mode);
+		}
+
+		/**
+		 * Reset and use memory owned by the caller. Only use at startup
+		 *
+		 * @param buffer Memory to use. Must be aligned to #TemAllocator::MinimumAllocationSize
+		 * @param len Size of the buffer in bytes
+		 * @param mode
+		 */
+		void init(void *buffer, const size_t len, const BuddyMode mode = BuddyMode::PowerOfTwo)
+		{
+			close();
+			data = static_cast<uint8_t *>(buffer);
+			reset(len, mode);
+		}
+
+		void *allocate(const size_t bytes)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			return allocateLocked(bytes);
+		}
+
+		/**
+		 * @brief Resize a block. Blocks that are already big enough are returned as is. Otherwise, the data is moved to
+		 * a new block
+		 *
+		 * @param ptr the block
+		 * @param bytes the new size
+		 *
+		 * @return the block
+		 */
+		void *reallocate(void *ptr, const size_t bytes)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			if (ptr == nullptr)
+			{
+				return allocateLocked(bytes);
+			}
+			const size_t oldSize = getBlockSize(ptr);
+			if (bytes <= oldSize)
+			{
+				return ptr;
+			}
+			void *newPtr = allocateLocked(bytes);
+			memcpy(newPtr, ptr, oldSize);
+			deallocateLocked(ptr);
+			return newPtr;
+		}
+
+		void deallocate(void *ptr)
+		{
+			if (ptr == nullptr)
+			{
+				return;
+			}
+			std::lock_guard<Mutex> g(mutex);
+			deallocateLocked(ptr);
+		}
+
+		size_t getBlockSize(const void *ptr) const
+		{
+			if (ptr == nullptr)
+			{
+				return 0;
+			}
+			const BlockHeader *header =
+				reinterpret_cast<const BlockHeader *>(static_cast<const uint8_t *>(ptr) - sizeof(BlockHeader));
+			return header->units * BuddyMinimumBlockSize - sizeof(BlockHeader);
+		}
+	};
+
+	template <class T>
+	using BuddyAllocator = EngineAllocator<T, BuddyAllocatorData>;
+} // namespace TemAllocator
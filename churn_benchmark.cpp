@@ -0,0 +1,105 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/**
+ * Allocation churn used to compare the placement policies. A 64 MiB arena has 20000 slots. Each operation picks a
+ * random slot and frees it if it is live or allocates into it otherwise. Most requests are 16-216 bytes and 1 in 8 is
+ * 300-2300 bytes. Every policy runs with and without the quick lists.
+ *
+ *     g++ -std=c++17 -O2 churn_benchmark.cpp -o churn_benchmark -lpthread
+ *     ./churn_benchmark [operations]
+ */
+
+#include "allocator.hpp"
+#include "perf_counters.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace TemAllocator;
+
+namespace
+{
+	constexpr size_t ChurnArenaSize = 64 << 20;
+	constexpr size_t ChurnSlots = 20000;
+
+	void churn(PerfCounters &counters, const PlacementPolicy policy, const char *name, const bool quickLists,
+			   const uint64_t operations)
+	{
+		AllocatorData ad;
+		ad.init(ChurnArenaSize, policy);
+		if (!quickLists)
+		{
+			ad.setQuickListThreshold(0);
+		}
+		Allocator<uint8_t> a(ad);
+		std::mt19937 rng(1);
+		std::vector<uint8_t *> live(ChurnSlots, nullptr);
+		size_t failed = 0;
+
+		const PerfCounterValues values = counters.measure(operations, [&]() {
+			for (uint64_t i = 0; i < operations; ++i)
+			{
+				uint8_t *&slot = live[rng() % live.size()];
+				if (slot != nullptr)
+				{
+					a.deallocate(slot);
+					slot = nullptr;
+				}
+				else
+				{
+					const size_t size = rng() % 8 == 0 ? 300 + rng() % 2000 : 16 + rng() % 200;
+					slot = a.try_allocate(size);
+					failed += slot == nullptr;
+				}
+			}
+		});
+
+		char title[64];
+		snprintf(title, sizeof(title), "%s%s", name, quickLists ? "" : " (no quick lists)");
+		values.print(stdout, title);
+		printf("\tfailed %zu\n", failed);
+		if (policy == PlacementPolicy::Good)
+		{
+			const GoodFitStats stats = ad.getGoodFitStats();
+			printf("\tsearches %zu exact %zu slack %zu cap %zu\n", stats.searches, stats.exactMatches,
+				   stats.slackMatches, stats.capHits);
+		}
+
+		for (uint8_t *p : live)
+		{
+			a.deallocate(p);
+		}
+	}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	const uint64_t operations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 400000;
+	const PlacementPolicy policies[] = {PlacementPolicy::First, PlacementPolicy::Next, PlacementPolicy::Best,
+										PlacementPolicy::Good};
+	const char *names[] = {"first", "next", "best", "good"};
+
+	PerfCounters counters;
+	for (const bool quickLists : {true, false})
+	{
+		for (size_t i = 0; i < 4; ++i)
+		{
+			churn(counters, policies[i], names[i], quickLists, operations);
+		}
+	}
+	return 0;
+}
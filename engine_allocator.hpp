@@ -0,0 +1,124 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "allocator.hpp"
+
+namespace TemAllocator
+{
+	/**
+	 * @brief STL allocator for allocator engines that work in bytes. An engine provides:
+	 *
+	 * - void *allocate(size_t bytes), throws #TemAllocator::bad_alloc on failure
+	 * - void *reallocate(void *ptr, size_t bytes)
+	 * - void deallocate(void *ptr)
+	 * - size_t getBlockSize(const void *ptr), the number of usable bytes in the block
+	 *
+	 * @tparam T type to allocate
+	 * @tparam Engine the engine type
+	 */
+	template <class T, class Engine>
+	class EngineAllocator
+	{
+	public:
+		typedef T value_type;
+
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+		typedef std::false_type propagate_on_container_copy_assignment;
+		typedef std::false_type is_always_equal;
+
+		template <class U>
+		struct rebind
+		{
+			typedef EngineAllocator<U, Engine> other;
+		};
+
+		template <class U, class E>
+		friend class EngineAllocator;
+
+	private:
+		Engine *engine;
+
+	public:
+		EngineAllocator(Engine &engine) noexcept : engine(&engine)
+		{
+		}
+
+		template <class U>
+		EngineAllocator(const EngineAllocator<U, Engine> &u) noexcept : engine(u.engine)
+		{
+		}
+		template <class U>
+		bool operator==(const EngineAllocator<U, Engine> &u) const noexcept
+		{
+			return engine == u.engine;
+		}
+		template <class U>
+		bool operator!=(const EngineAllocator<U, Engine> &u) const noexcept
+		{
+			return engine != u.engine;
+		}
+
+		Engine &getData() const noexcept
+		{
+			return *engine;
+		}
+
+		/**
+		 * @brief Allocate a number of type T
+		 *
+		 * @param n Number of T's to allocate
+		 *
+		 * @return pointer to allocated data
+		 */
+		T *allocate(const size_t n = 1)
+		{
+			if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			{
+				throwBadAlloc();
+			}
+			return static_cast<T *>(engine->allocate(sizeof(T) * n));
+		}
+
+		/**
+		 * @brief Re-allocate a number of type T. Extends the block in place if possible
+		 *
+		 * @param ptr Pointer to the old data
+		 * @param n Number of T's to allocate
+		 *
+		 * @return pointer to allocated data
+		 */
+		T *reallocate(T *ptr, const size_t n)
+		{
+			if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			{
+				throwBadAlloc();
+			}
+			return static_cast<T *>(engine->reallocate(ptr, sizeof(T) * n));
+		}
+
+		void deallocate(T *const p, const size_t = 1)
+		{
+			engine->deallocate(p);
+		}
+
+		size_t getBlockSize(const T *const p) const
+		{
+			return engine->getBlockSize(p);
+		}
+	};
+} // namespace TemAllocator
@@ -1,8 +1,12 @@
+#pragma once
+
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <array>
 #include <cstring>
 #include <stdexcept>
+#include <type_traits>
 
 namespace TemAllocator
 {
@@ -86,16 +90,24 @@ namespace TemAllocator
         template <class T2, class D2>
         friend class LinearAllocator;
 
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+        typedef std::false_type propagate_on_container_copy_assignment;
+        typedef std::false_type is_always_equal;
+
     private:
-        LinearAllocatorData<D> &data;
+        LinearAllocatorData<D> *data;
 
     public:
-        LinearAllocator(LinearAllocatorData<D> &a) noexcept : data(a) {}
+        LinearAllocator(LinearAllocatorData<D> &a) noexcept : data(&a) {}
 
         LinearAllocator() = delete;
         LinearAllocator(const LinearAllocator &u) noexcept : data(u.data) {}
         LinearAllocator(LinearAllocator &&u) noexcept : data(u.data) {}
 
+        LinearAllocator &operator=(const LinearAllocator &) noexcept = default;
+        LinearAllocator &operator=(LinearAllocator &&) noexcept = default;
+
         ~LinearAllocator() {}
 
         template <class U>
@@ -104,14 +116,14 @@ namespace TemAllocator
         LinearAllocator(LinearAllocator<U, D> &&u) noexcept : data(u.data) {}
 
         template <class U>
-        bool operator==(const LinearAllocator<U, D> &) const noexcept
+        bool operator==(const LinearAllocator<U, D> &u) const noexcept
         {
-            return true;
+            return data == u.data;
         }
         template <class U>
-        bool operator!=(const LinearAllocator<U, D> &) const noexcept
+        bool operator!=(const LinearAllocator<U, D> &u) const noexcept
         {
-            return false;
+            return data != u.data;
         }
 
         /**
@@ -121,7 +133,7 @@ namespace TemAllocator
          */
         size_t getTotal() const noexcept
         {
-            return data.getBufferSize();
+            return data->getBufferSize();
         }
 
         /**
@@ -131,7 +143,7 @@ namespace TemAllocator
          */
         size_t getUsed() const noexcept
         {
-            return data.used;
+            return data->used;
         }
 
         /**
@@ -139,7 +151,7 @@ namespace TemAllocator
          */
         void clear(bool hard = false) noexcept
         {
-            data.clear(hard);
+            data->clear(hard);
         }
 
         static size_t calculatePadding(size_t current)
@@ -170,82 +182,130 @@ namespace TemAllocator
             }
         };
 
+        [[noreturn]] static void throwBadAlloc()
+        {
+#if __cpp_exceptions
+            throw bad_alloc();
+#else
+            abort();
+#endif
+        }
+
+        /**
+         * @brief Allocate a number of T's. Throws #bad_alloc (or aborts when exceptions are disabled) if they can
+         * never fit in the buffer
+         *
+         * @param count Number of T's to allocate
+         *
+         * @return pointer to allocated data
+         */
         T *allocate(size_t count = 1)
         {
-            if (count == 0)
+            T *ptr = try_allocate(count);
+            if (ptr == nullptr && count != 0)
             {
-                return nullptr;
+                throwBadAlloc();
             }
+            return ptr;
+        }
 
-            const size_t size = sizeof(T) * count;
-            if (size > data.getBufferSize())
+        /**
+         * @brief Allocate a number of T's without throwing
+         *
+         * @param count Number of T's to allocate
+         *
+         * @return pointer to allocated data or nullptr if they can never fit in the buffer
+         */
+        T *try_allocate(size_t count = 1) noexcept
+        {
+            if (count == 0 || count > data->getBufferSize() / sizeof(T))
             {
-                throw bad_alloc();
+                return nullptr;
             }
 
-            uint8_t *buffer = data.getBuffer();
+            const size_t size = sizeof(T) * count;
+
+            uint8_t *buffer = data->getBuffer();
             size_t currentAddress =
-                reinterpret_cast<size_t>(buffer) + static_cast<size_t>(data.used);
+                reinterpret_cast<size_t>(buffer) + static_cast<size_t>(data->used);
 
             size_t padding = 0;
-            if (alignof(T) != 0 && (data.used % alignof(T)) != 0)
+            if (alignof(T) != 0 && (data->used % alignof(T)) != 0)
             {
                 padding = calculatePadding(currentAddress);
             }
 
-            if (data.used + padding + size > data.getBufferSize())
+            if (data->used + padding + size > data->getBufferSize())
             {
                 clear();
                 currentAddress = reinterpret_cast<size_t>(buffer);
-                data.used = 0;
+                data->used = 0;
                 padding = 0;
             }
 
-            data.used += padding;
+            data->used += padding;
             const size_t nextAddress = currentAddress + padding;
-            data.used += size;
-            data.previousAllocationSize = size;
+            data->used += size;
+            data->previousAllocationSize = size;
             return reinterpret_cast<T *>(nextAddress);
         }
 
         T *reallocate(T *oldPtr, size_t count = 1)
         {
-            const size_t newSize = sizeof(T) * count;
-            if (newSize > data.getBufferSize())
+            T *ptr = try_reallocate(oldPtr, count);
+            if (ptr == nullptr && count != 0)
             {
-                throw bad_alloc();
+                throwBadAlloc();
             }
+            return ptr;
+        }
+
+        /**
+         * @brief Re-allocate a number of T's without throwing
+         *
+         * @param oldPtr Pointer to the old data
+         * @param count Number of T's to allocate
+         *
+         * @return pointer to allocated data or nullptr if they can never fit in the buffer
+         */
+        T *try_reallocate(T *oldPtr, size_t count = 1) noexcept
+        {
+            if (count > data->getBufferSize() / sizeof(T))
+            {
+                return nullptr;
+            }
+            const size_t newSize = sizeof(T) * count;
 
-            if (data.previousAllocationSize > data.used)
+            if (data->previousAllocationSize > data->used)
             {
                 goto doAllocation;
             }
 
             {
-                uint8_t *buffer = data.getBuffer();
-                void *previousAllocation = &buffer[data.used - data.previousAllocationSize];
+                uint8_t *buffer = data->getBuffer();
+                void *previousAllocation = &buffer[data->used - data->previousAllocationSize];
                 if (oldPtr != nullptr && previousAllocation == oldPtr)
                 {
-                    if (data.previousAllocationSize > newSize)
+                    if (data->previousAllocationSize > newSize)
                     {
-                        data.used -= data.previousAllocationSize - newSize;
+                        data->used -= data->previousAllocationSize - newSize;
                     }
                     else
                     {
-                        const size_t diff = newSize - data.previousAllocationSize;
-                        if (data.used + diff >= data.getBufferSize())
+                        const size_t diff = newSize - data->previousAllocationSize;
+                        if (data->used + diff >= data->getBufferSize())
                         {
                             goto doAllocation;
                         }
-                        data.used += diff;
+                        data->used += diff;
                     }
-                    data.previousAllocationSize = newSize;
+                    data->previousAllocationSize = newSize;
                     return oldPtr;
                 }
             }
 
         doAllocation:
-            T *newData = allocate(count);
+            T *newData = try_allocate(count);
 
             if (newData != nullptr && oldPtr != nullptr)
             {
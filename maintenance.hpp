@@ -0,0 +1,253 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+namespace TemAllocator
+{
+	/**
+	 * Number of quick list blocks moved each time the arena lock is taken by #TemAllocator::BasicArenaMaintainer
+	 */
+	constexpr size_t MaintenanceBlocksPerStep = 64;
+
+	/**
+	 * Default number of bytes #TemAllocator::BasicArenaMaintainer leaves in the quick lists for reuse
+	 */
+	constexpr size_t DefaultMaintenanceQuickListTarget = DefaultQuickListThreshold / 4;
+
+	/**
+	 * @brief Check if an arena has no lock (see #TemAllocator::NullLock)
+	 *
+	 * @tparam Data the arena type
+	 */
+	template <class Data>
+	struct IsUnlockedArena : std::false_type
+	{
+	};
+	template <class Policy>
+	struct IsUnlockedArena<BasicAllocatorData<Policy, NullLock>> : std::true_type
+	{
+	};
+
+	/**
+	 * @brief Optional background thread that does the housekeeping of an arena off the request path. Each period it
+	 * combines blocks from the quick lists with their neighbors and gives the free pages at the end of the heap back to
+	 * the operating system (see #TemAllocator::BasicAllocatorData::purge). The work is done in small steps that each
+	 * hold the arena lock briefly and stops when the duty cycle of the period is used up.
+	 *
+	 * Must be stopped (or destroyed) before the arena is. The arena must have a real lock since it is used from two
+	 * threads.
+	 *
+	 * @tparam Data the arena type
+	 */
+	template <class Data>
+	class BasicArenaMaintainer
+	{
+		static_assert(!IsUnlockedArena<Data>::value, "The maintainer thread can't share an arena that has no lock");
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		Data &ad;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::chrono::microseconds period;
+		double dutyCycle;
+		size_t quickListTarget;
+		size_t consolidatedBlocks;
+		size_t purgedBytes;
+		bool stopping;
+
+		/**
+		 * @brief Do the housekeeping until there is none left or the deadline passes
+		 *
+		 * @param deadline when to stop
+		 * @param target bytes to leave in the quick lists
+		 */
+		void runUntil(const Clock::time_point deadline, const size_t target)
+		{
+			size_t blocks = 0;
+			while (Clock::now() < deadline)
+			{
+				const size_t moved = ad.consolidate(target, MaintenanceBlocksPerStep);
+				blocks += moved;
+				if (moved < MaintenanceBlocksPerStep)
+				{
+					break;
+				}
+			}
+			const size_t purged = Clock::now() < deadline ? ad.purge() : 0;
+
+			std::lock_guard<std::mutex> g(mutex);
+			consolidatedBlocks += blocks;
+			purgedBytes += purged;
+		}
+
+		/**
+		 * @brief Keep a duty cycle between 0 and 1. NaN becomes 0
+		 */
+		static double clampDutyCycle(const double dutyCycle) noexcept
+		{
+			return dutyCycle > 0.0 ? std::min(dutyCycle, 1.0) : 0.0;
+		}
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping)
+			{
+				const auto start = Clock::now();
+				const auto period = this->period;
+				const auto budget = std::chrono::duration_cast<Clock::duration>(period * dutyCycle);
+				const size_t target = quickListTarget;
+
+				lock.unlock();
+				runUntil(start + budget, target);
+				lock.lock();
+
+				condition.wait_until(lock, start + period, [this]() { return stopping; });
+			}
+		}
+
+	public:
+		/**
+		 * @param ad the arena
+		 * @param period time between the starts of two rounds of work
+		 * @param dutyCycle fraction of the period that may be spent working. Between 0 and 1
+		 * @param quickListTarget bytes to leave in the quick lists so recently freed sizes can still be reused
+		 */
+		explicit BasicArenaMaintainer(Data &ad,
+									  const std::chrono::microseconds period = std::chrono::milliseconds(10),
+									  const double dutyCycle = 0.1,
+									  const size_t quickListTarget = DefaultMaintenanceQuickListTarget)
+			: ad(ad), thread(), mutex(), condition(), period(period), dutyCycle(clampDutyCycle(dutyCycle)),
+			  quickListTarget(quickListTarget), consolidatedBlocks(0), purgedBytes(0), stopping(false)
+		{
+		}
+		BasicArenaMaintainer(const BasicArenaMaintainer &) = delete;
+		BasicArenaMaintainer(BasicArenaMaintainer &&) = delete;
+
+		~BasicArenaMaintainer()
+		{
+			stop();
+		}
+
+		/**
+		 * @brief Start the thread. Does nothing if it is already running
+		 */
+		void start()
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			if (thread.joinable())
+			{
+				return;
+			}
+			stopping = false;
+			thread = std::thread(&BasicArenaMaintainer::run, this);
+		}
+
+		/**
+		 * @brief Stop the thread and wait for the current round of work to finish. Does nothing if it is not running
+		 */
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> g(mutex);
+				if (!thread.joinable())
+				{
+					return;
+				}
+				stopping = true;
+			}
+			condition.notify_all();
+			thread.join();
+		}
+
+		bool isRunning()
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			return thread.joinable();
+		}
+
+		/**
+		 * @brief Change the duty cycle. Takes effect in the next period
+		 *
+		 * @param period time between the starts of two rounds of work
+		 * @param dutyCycle fraction of the period that may be spent working. Between 0 and 1
+		 */
+		void setDutyCycle(const std::chrono::microseconds period, const double dutyCycle)
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			this->period = period;
+			this->dutyCycle = clampDutyCycle(dutyCycle);
+		}
+
+		/**
+		 * @brief Change the number of bytes left in the quick lists. Takes effect in the next period
+		 *
+		 * @param bytes the target
+		 */
+		void setQuickListTarget(const size_t bytes)
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			quickListTarget = bytes;
+		}
+
+		/**
+		 * @brief Do one round of work on the calling thread. Works with or without the thread running
+		 *
+		 * @param budget maximum time to spend
+		 */
+		void runOnce(const std::chrono::microseconds budget)
+		{
+			size_t target;
+			{
+				std::lock_guard<std::mutex> g(mutex);
+				target = quickListTarget;
+			}
+			runUntil(Clock::now() + budget, target);
+		}
+
+		/**
+		 * @brief Get the number of quick list blocks combined with their neighbors so far
+		 *
+		 * @return number of blocks
+		 */
+		size_t getConsolidatedBlocks()
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			return consolidatedBlocks;
+		}
+
+		/**
+		 * @brief Get the number of bytes given back to the operating system so far
+		 *
+		 * @return number of bytes
+		 */
+		size_t getPurgedBytes()
+		{
+			std::lock_guard<std::mutex> g(mutex);
+			return purgedBytes;
+		}
+	};
+
+	using ArenaMaintainer = BasicArenaMaintainer<AllocatorData>;
+} // namespace TemAllocator
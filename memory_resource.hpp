@@ -0,0 +1,209 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "allocator.hpp"
+#include "linear_allocator.hpp"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace TemAllocator
+{
+	/**
+	 * @brief Memory resource that allocates from a free list allocator's data
+	 */
+	class AllocatorResource : public std::pmr::memory_resource
+	{
+	private:
+		AllocatorData &ad;
+
+	public:
+		explicit AllocatorResource(AllocatorData &ad) noexcept : ad(ad)
+		{
+		}
+		AllocatorResource(const AllocatorResource &) = delete;
+		AllocatorResource &operator=(const AllocatorResource &) = delete;
+
+		AllocatorData &getData() const noexcept
+		{
+			return ad;
+		}
+
+	protected:
+		void *do_allocate(const size_t bytes, const size_t alignment) override
+		{
+			Allocator<uint8_t> a(ad);
+			if (alignment <= MinimumAllocationSize)
+			{
+				return a.allocate(std::max<size_t>(bytes, 1));
+			}
+
+			// Blocks are only aligned to MinimumAllocationSize. Over-allocate and store the block's pointer right
+			// before the aligned pointer. There is always room for it since the block is at least MinimumAllocationSize
+			// aligned.
+			if (bytes > std::numeric_limits<size_t>::max() - alignment)
+			{
+				throwBadAlloc();
+			}
+			uint8_t *block = a.allocate(bytes + alignment);
+			const size_t address = alignForward(reinterpret_cast<size_t>(block) + sizeof(uint8_t *), alignment);
+			memcpy(reinterpret_cast<void *>(address - sizeof(uint8_t *)), &block, sizeof(uint8_t *));
+			return reinterpret_cast<void *>(address);
+		}
+
+		void do_deallocate(void *p, const size_t, const size_t alignment) override
+		{
+			Allocator<uint8_t> a(ad);
+			uint8_t *block = static_cast<uint8_t *>(p);
+			if (alignment > MinimumAllocationSize)
+			{
+				memcpy(&block, static_cast<uint8_t *>(p) - sizeof(uint8_t *), sizeof(uint8_t *));
+			}
+			a.deallocate(block);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+		{
+			const AllocatorResource *r = dynamic_cast<const AllocatorResource *>(&other);
+			return r != nullptr && &r->ad == &ad;
+		}
+	};
+
+	/**
+	 * @brief Monotonic memory resource that allocates from a linear allocator's data.
+	 *
+	 * Deallocation is a no-op for memory inside of the buffer. When the buffer is full, requests are passed to the
+	 * upstream resource instead of wrapping around like #TemAllocator::LinearAllocator does.
+	 *
+	 * @tparam D the linear allocator data type
+	 */
+	template <typename D>
+	class LinearResource : public std::pmr::memory_resource
+	{
+	private:
+		LinearAllocatorData<D> &data;
+		std::pmr::memory_resource *upstream;
+
+		bool inBuffer(const void *p)
+		{
+			const size_t address = reinterpret_cast<size_t>(p);
+			const size_t start = reinterpret_cast<size_t>(data.getBuffer());
+			return address >= start && address < start + data.getBufferSize();
+		}
+
+	public:
+		explicit LinearResource(LinearAllocatorData<D> &data,
+								std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+			: data(data), upstream(upstream)
+		{
+		}
+		LinearResource(const LinearResource &) = delete;
+		LinearResource &operator=(const LinearResource &) = delete;
+
+		std::pmr::memory_resource *getUpstream() const noexcept
+		{
+			return upstream;
+		}
+
+		/**
+		 * @brief Release all memory in the buffer. Memory from the upstream resource is not affected
+		 */
+		void release(bool hard = false) noexcept
+		{
+			data.clear(hard);
+		}
+
+	protected:
+		void *do_allocate(const size_t bytes, const size_t alignment) override
+		{
+			const size_t start = reinterpret_cast<size_t>(data.getBuffer());
+			const size_t address = alignForward(start + data.used, alignment);
+			// Compare sizes instead of addresses so a large request cannot wrap around
+			const size_t offset = address - start;
+			if (offset <= data.getBufferSize() && bytes <= data.getBufferSize() - offset)
+			{
+				data.used = offset + bytes;
+				data.previousAllocationSize = bytes;
+				return reinterpret_cast<void *>(address);
+			}
+			return upstream->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void *p, const size_t bytes, const size_t alignment) override
+		{
+			if (!inBuffer(p))
+			{
+				upstream->deallocate(p, bytes, alignment);
+			}
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	namespace pmr
+	{
+		using String = std::pmr::string;
+		using String32 = std::pmr::u32string;
+
+		using StringStream =
+			std::basic_stringstream<char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>>;
+		using OStringStream =
+			std::basic_ostringstream<char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>>;
+		using IStringStream =
+			std::basic_istringstream<char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>>;
+
+		template <typename T>
+		using List = std::pmr::vector<T>;
+
+		template <typename T>
+		using Deque = std::pmr::deque<T>;
+
+		template <typename K>
+		using Set = std::pmr::unordered_set<K>;
+
+		template <typename K>
+		using OrderedSet = std::pmr::set<K>;
+
+		template <typename K, typename V>
+		using Map = std::pmr::unordered_map<K, V>;
+
+		template <typename K, typename V>
+		using OrderedMap = std::pmr::map<K, V>;
+
+		template <typename T>
+		using LinkedList = std::pmr::list<T>;
+
+		template <typename T>
+		using Queue = std::queue<T, Deque<T>>;
+
+		template <typename T>
+		using Stack = std::stack<T, Deque<T>>;
+	} // namespace pmr
+} // namespace TemAllocator
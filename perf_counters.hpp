@@ -0,0 +1,311 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace TemAllocator
+{
+	/**
+	 * @brief Hardware events sampled by #TemAllocator::PerfCounters
+	 */
+	enum class PerfEvent
+	{
+		Cycles,
+		Instructions,
+		L1DMisses,
+		LLCMisses,
+		DTLBMisses,
+		BranchMisses,
+		Count
+	};
+
+	constexpr size_t PerfEventCount = static_cast<size_t>(PerfEvent::Count);
+
+	/**
+	 * @brief Counter values for one measured workload
+	 */
+	struct PerfCounterValues
+	{
+		uint64_t values[PerfEventCount];
+		bool valid[PerfEventCount];
+		uint64_t nanoseconds;
+		uint64_t operations;
+
+		static const char *getName(const PerfEvent e) noexcept
+		{
+			switch (e)
+			{
+			case PerfEvent::Cycles:
+				return "cycles";
+			case PerfEvent::Instructions:
+				return "instructions";
+			case PerfEvent::L1DMisses:
+				return "L1d-misses";
+			case PerfEvent::LLCMisses:
+				return "LLC-misses";
+			case PerfEvent::DTLBMisses:
+				return "dTLB-misses";
+			case PerfEvent::BranchMisses:
+				return "branch-misses";
+			default:
+				return "unknown";
+			}
+		}
+
+		/**
+		 * @brief Get the value of an event divided by the number of operations
+		 *
+		 * @param e the event
+		 *
+		 * @return value per operation or a negative number if the event was not counted
+		 */
+		double perOperation(const PerfEvent e) const noexcept
+		{
+			const size_t i = static_cast<size_t>(e);
+			if (!valid[i])
+			{
+				return -1.0;
+			}
+			return static_cast<double>(values[i]) / static_cast<double>(operations == 0 ? 1 : operations);
+		}
+
+		/**
+		 * @brief Write one line per event with the per operation value
+		 *
+		 * @param f the file to write to
+		 * @param name name of the workload
+		 */
+		void print(FILE *f, const char *name) const
+		{
+			const uint64_t ops = operations == 0 ? 1 : operations;
+			fprintf(f, "%s: %llu ops, %.2f ns/op\n", name, static_cast<unsigned long long>(operations),
+					static_cast<double>(nanoseconds) / static_cast<double>(ops));
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				const PerfEvent e = static_cast<PerfEvent>(i);
+				if (valid[i])
+				{
+					fprintf(f, "\t%-14s %.3f/op\n", getName(e), perOperation(e));
+				}
+				else
+				{
+					fprintf(f, "\t%-14s unavailable\n", getName(e));
+				}
+			}
+		}
+	};
+
+	/**
+	 * @brief Hardware performance counters for the calling thread using perf_event_open.
+	 *
+	 * Every event is opened on its own so an event the CPU (or a virtual machine) does not support only invalidates that
+	 * event. When no counter could be opened (non-Linux, perf_event_paranoid, containers), #available returns false and
+	 * measurements only report wall time.
+	 */
+	class PerfCounters
+	{
+	private:
+		int fds[PerfEventCount];
+		std::chrono::steady_clock::time_point startTime;
+
+#if __linux__
+		static int open(const uint32_t type, const uint64_t config) noexcept
+		{
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = type;
+			attr.config = config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+
+		static constexpr uint64_t cacheConfig(const uint64_t cache, const uint64_t op, const uint64_t result)
+		{
+			return cache | (op << 8) | (result << 16);
+		}
+#endif
+
+	public:
+		PerfCounters() noexcept : fds(), startTime()
+		{
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				fds[i] = -1;
+			}
+#if __linux__
+			fds[static_cast<size_t>(PerfEvent::Cycles)] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+			fds[static_cast<size_t>(PerfEvent::Instructions)] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+			fds[static_cast<size_t>(PerfEvent::L1DMisses)] =
+				open(PERF_TYPE_HW_CACHE,
+					 cacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+			fds[static_cast<size_t>(PerfEvent::LLCMisses)] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+			fds[static_cast<size_t>(PerfEvent::DTLBMisses)] =
+				open(PERF_TYPE_HW_CACHE,
+					 cacheConfig(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+			fds[static_cast<size_t>(PerfEvent::BranchMisses)] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+		}
+		PerfCounters(const PerfCounters &) = delete;
+		PerfCounters(PerfCounters &&) = delete;
+
+		~PerfCounters()
+		{
+#if __linux__
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				if (fds[i] >= 0)
+				{
+					::close(fds[i]);
+				}
+			}
+#endif
+		}
+
+		/**
+		 * @brief Check if at least one hardware counter could be opened
+		 *
+		 * @return true if counters are available
+		 */
+		bool available() const noexcept
+		{
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				if (fds[i] >= 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		 * @brief Reset and enable all counters
+		 */
+		void start() noexcept
+		{
+#if __linux__
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				if (fds[i] >= 0)
+				{
+					ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+					ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+#endif
+			startTime = std::chrono::steady_clock::now();
+		}
+
+		/**
+		 * @brief Disable all counters and read them. Values are scaled when the kernel multiplexed the counters.
+		 *
+		 * @param operations Number of operations the workload performed
+		 *
+		 * @return the counter values
+		 */
+		PerfCounterValues stop(const uint64_t operations) noexcept
+		{
+			const auto endTime = std::chrono::steady_clock::now();
+			PerfCounterValues result;
+			memset(&result, 0, sizeof(result));
+			result.operations = operations;
+			result.nanoseconds = static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count());
+#if __linux__
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				if (fds[i] >= 0)
+				{
+					ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+				}
+			}
+			for (size_t i = 0; i < PerfEventCount; ++i)
+			{
+				// value, time enabled, time running
+				uint64_t data[3];
+				if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+				{
+					continue;
+				}
+				result.values[i] = data[2] == data[1]
+									   ? data[0]
+									   : static_cast<uint64_t>(static_cast<double>(data[0]) *
+															   (static_cast<double>(data[1]) / static_cast<double>(data[2])));
+				result.valid[i] = true;
+			}
+#endif
+			return result;
+		}
+
+		/**
+		 * @brief Run a workload with the counters enabled
+		 *
+		 * @tparam F the workload type
+		 * @param operations Number of operations the workload performs
+		 * @param f the workload
+		 *
+		 * @return the counter values
+		 */
+		template <typename F>
+		PerfCounterValues measure(const uint64_t operations, F &&f)
+		{
+			start();
+			f();
+			return stop(operations);
+		}
+	};
+
+	/**
+	 * @brief Measure the enclosing scope and print the per operation results when it ends
+	 */
+	class ScopedPerfCounters
+	{
+	private:
+		PerfCounters &counters;
+		const char *name;
+		uint64_t operations;
+		FILE *file;
+
+	public:
+		ScopedPerfCounters(PerfCounters &counters, const char *name, const uint64_t operations,
+						   FILE *file = stdout) noexcept
+			: counters(counters), name(name), operations(operations), file(file)
+		{
+			counters.start();
+		}
+		ScopedPerfCounters(const ScopedPerfCounters &) = delete;
+		ScopedPerfCounters(ScopedPerfCounters &&) = delete;
+
+		~ScopedPerfCounters()
+		{
+			counters.stop(operations).print(file, name);
+		}
+	};
+} // namespace TemAllocator
@@ -0,0 +1,352 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+namespace TemAllocator
+{
+	constexpr uint64_t PersistentHeapMagic = 0x50414548504d4554ULL; // "TEMPHEAP"
+	constexpr uint32_t PersistentHeapVersion = 1;
+
+	/**
+	 * @brief Stored at the start of a persistent heap file. A file is only reopened if every field matches the current
+	 * build.
+	 */
+	struct PersistentHeapHeader
+	{
+		uint64_t magic;
+		uint32_t version;
+		uint32_t layout;
+		uint64_t baseAddress;
+		uint64_t length;
+		void *root;
+
+		/**
+		 * @brief Get a value that changes when the layout of the allocator's data changes
+		 *
+		 * @return the layout value
+		 */
+		static constexpr uint32_t getLayout()
+		{
+			return static_cast<uint32_t>(sizeof(AllocatorData) | (alignof(AllocatorData) << 12) |
+										 (sizeof(FreeListNode) << 18) | (MinimumAllocationSize << 24) |
+										 (sizeof(void *) << 28));
+		}
+	};
+
+	class PersistentHeapError : public std::runtime_error
+	{
+	public:
+		explicit PersistentHeapError(const std::string &message) : std::runtime_error(message)
+		{
+		}
+	};
+
+	/**
+	 * @brief Free list allocator data whose memory is a file mapped at a fixed address.
+	 *
+	 * The allocator's data and its free list live inside of the file. Since the file is always mapped at the same
+	 * address, pointers stored in the heap (including the ones inside of containers using #TemAllocator::Allocator)
+	 * stay valid when a restarted process reopens the file. Use #setRoot to find the containers again.
+	 *
+	 * File layout: PersistentHeapHeader, AllocatorData, memory blocks
+	 */
+	class PersistentHeap
+	{
+	private:
+		PersistentHeapHeader *header;
+		AllocatorData *ad;
+		int fd;
+		size_t len;
+
+		static constexpr size_t getDataOffset()
+		{
+			return (sizeof(PersistentHeapHeader) + alignof(AllocatorData) - 1) & ~(alignof(AllocatorData) - 1);
+		}
+
+		static constexpr size_t getArenaOffset()
+		{
+			return (getDataOffset() + sizeof(AllocatorData) + MinimumAllocationSize - 1) &
+				   ~(MinimumAllocationSize - 1);
+		}
+
+		/**
+		 * @brief Removes a file that #open created unless it is dismissed
+		 */
+		struct RemoveOnFailure
+		{
+			const char *path;
+
+			~RemoveOnFailure()
+			{
+				if (path != nullptr)
+				{
+					::unlink(path);
+				}
+			}
+		};
+
+		/**
+		 * @brief Check if the header was left by a creation that did not finish. The magic is written last. So, the
+		 * other fields are either still zero or what this build writes.
+		 */
+		bool isUnfinished(const void *baseAddress, const size_t len) const noexcept
+		{
+			if (header->magic != 0)
+			{
+				return false;
+			}
+			const bool zero =
+				header->version == 0 && header->layout == 0 && header->baseAddress == 0 && header->length == 0;
+			const bool matches = header->version == PersistentHeapVersion &&
+								 header->layout == PersistentHeapHeader::getLayout() &&
+								 header->baseAddress == reinterpret_cast<uint64_t>(baseAddress) && header->length == len;
+			return zero || matches;
+		}
+
+		[[noreturn]] void fail(const char *message)
+		{
+			const int error = errno;
+			close();
+			std::string s(message);
+			if (error != 0)
+			{
+				s += ": ";
+				s += strerror(error);
+			}
+			throwError(s);
+		}
+
+		/**
+		 * @brief Throw #TemAllocator::PersistentHeapError. Aborts when exceptions are disabled
+		 */
+		[[noreturn]] static void throwError(const std::string &message)
+		{
+#if __cpp_exceptions
+			throw PersistentHeapError(message);
+#else
+			(void)message;
+			abort();
+#endif
+		}
+
+	public:
+		PersistentHeap() noexcept : header(nullptr), ad(nullptr), fd(-1), len(0)
+		{
+		}
+		PersistentHeap(const PersistentHeap &) = delete;
+		PersistentHeap(PersistentHeap &&) = delete;
+
+		~PersistentHeap()
+		{
+			close();
+		}
+
+		/**
+		 * @brief Create or reopen a heap file. A file whose creation did not finish is created again. A file created by
+		 * this call is removed if it fails
+		 *
+		 * @param path Path to the file
+		 * @param baseAddress Address to map the file at. Must be page aligned and the same every time the file is opened
+		 * @param len Size of the file in bytes. Must match the size of an existing file
+		 * @param policy Placement policy of a new heap
+		 *
+		 * @return true if the file was created and false if an existing heap was reopened
+		 */
+		bool open(const char *path, void *baseAddress, const size_t len,
+				  const PlacementPolicy policy = PlacementPolicy::Best)
+		{
+			close();
+			errno = 0;
+
+			if (len <= getArenaOffset() + sizeof(FreeListNode))
+			{
+				fail("Persistent heap is too small");
+			}
+
+			RemoveOnFailure remove{path};
+			fd = ::open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+			if (fd < 0 && errno == EEXIST)
+			{
+				remove.path = nullptr;
+				fd = ::open(path, O_RDWR);
+			}
+			if (fd < 0)
+			{
+				remove.path = nullptr;
+				fail("Failed to open persistent heap file");
+			}
+
+			struct stat st;
+			if (fstat(fd, &st) != 0)
+			{
+				fail("Failed to stat persistent heap file");
+			}
+
+			bool created = st.st_size == 0;
+			if (created)
+			{
+				if (ftruncate(fd, static_cast<off_t>(len)) != 0)
+				{
+					fail("Failed to resize persistent heap file");
+				}
+			}
+			else if (static_cast<size_t>(st.st_size) != len)
+			{
+				errno = 0;
+				fail("Persistent heap file has a different size");
+			}
+
+			void *p = mmap(baseAddress, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+			if (p == MAP_FAILED)
+			{
+				fail("Failed to map persistent heap file");
+			}
+			this->len = len;
+			header = static_cast<PersistentHeapHeader *>(p);
+			if (p != baseAddress)
+			{
+				// Kernels before 4.17 treat the address as a hint
+				errno = 0;
+				fail("Persistent heap could not be mapped at its base address");
+			}
+
+			ad = reinterpret_cast<AllocatorData *>(static_cast<uint8_t *>(p) + getDataOffset());
+			created = created || isUnfinished(baseAddress, len);
+			if (created)
+			{
+				header->magic = 0;
+				header->version = PersistentHeapVersion;
+				header->layout = PersistentHeapHeader::getLayout();
+				header->baseAddress = reinterpret_cast<uint64_t>(baseAddress);
+				header->length = len;
+				header->root = nullptr;
+				new (ad) AllocatorData();
+				ad->init(static_cast<uint8_t *>(p) + getArenaOffset(), len - getArenaOffset(), policy);
+
+				// The magic is written last so a file that was only partly written is never taken for a heap
+				if (msync(header, len, MS_SYNC) != 0)
+				{
+					fail("Failed to sync persistent heap file");
+				}
+				__atomic_store_n(&header->magic, PersistentHeapMagic, __ATOMIC_RELEASE);
+				remove.path = nullptr;
+				return true;
+			}
+			remove.path = nullptr;
+
+			errno = 0;
+			if (header->magic != PersistentHeapMagic)
+			{
+				fail("File is not a persistent heap");
+			}
+			if (header->version != PersistentHeapVersion || header->layout != PersistentHeapHeader::getLayout())
+			{
+				fail("Persistent heap was created by an incompatible version");
+			}
+			if (header->baseAddress != reinterpret_cast<uint64_t>(baseAddress) || header->length != len)
+			{
+				fail("Persistent heap was created with a different base address or size");
+			}
+			ad->reattach();
+			return false;
+		}
+
+		bool isOpen() const noexcept
+		{
+			return header != nullptr;
+		}
+
+		/**
+		 * @brief Get the data to construct allocators with
+		 *
+		 * @return the data
+		 */
+		AllocatorData &getData() const noexcept
+		{
+			return *ad;
+		}
+
+		/**
+		 * @brief Get the object that was stored with #setRoot
+		 *
+		 * @tparam T type of the object
+		 *
+		 * @return the object or nullptr
+		 */
+		template <typename T>
+		T *getRoot() const noexcept
+		{
+			return static_cast<T *>(header->root);
+		}
+
+		/**
+		 * @brief Store the object that a reopened heap should start from. Must be allocated from this heap
+		 *
+		 * @param root the object
+		 */
+		void setRoot(void *root) noexcept
+		{
+			header->root = root;
+		}
+
+		/**
+		 * @brief Write the heap to the file. Should be called when no other thread is allocating
+		 */
+		void sync()
+		{
+			if (header != nullptr && msync(header, len, MS_SYNC) != 0)
+			{
+				throwError(std::string("Failed to sync persistent heap: ") + strerror(errno));
+			}
+		}
+
+		/**
+		 * @brief Write and unmap the heap. Pointers into the heap are no longer valid
+		 */
+		void close() noexcept
+		{
+			if (header != nullptr)
+			{
+				msync(header, len, MS_SYNC);
+				munmap(header, len);
+				header = nullptr;
+				ad = nullptr;
+				len = 0;
+			}
+			if (fd >= 0)
+			{
+				::close(fd);
+				fd = -1;
+			}
+		}
+	};
+} // namespace TemAllocator
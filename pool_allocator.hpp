@@ -0,0 +1,375 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <cstdint>
+
+namespace TemAllocator
+{
+	constexpr size_t PoolChunkSize = 64 * 1024;
+	constexpr size_t PoolMaxSlotSize = 256;
+	constexpr size_t PoolClassCount = PoolMaxSlotSize / MinimumAllocationSize;
+
+	/**
+	 * @brief Check if single objects of a type are served from pools
+	 */
+	template <typename T>
+	constexpr bool isPoolable()
+	{
+		return sizeof(T) <= PoolMaxSlotSize && alignof(T) <= MinimumAllocationSize;
+	}
+
+	/**
+	 * @brief Get the index of the pool that serves a type
+	 */
+	template <typename T>
+	constexpr size_t getPoolClass()
+	{
+		return (sizeof(T) + MinimumAllocationSize - 1) / MinimumAllocationSize - 1;
+	}
+
+	namespace Pool
+	{
+		struct FreeSlot
+		{
+			FreeSlot *next;
+		};
+
+		/**
+		 * Header of every chunk taken from the AllocatorData. Keeps slots aligned to MinimumAllocationSize
+		 */
+		struct Chunk
+		{
+			Chunk *next;
+			size_t unused;
+		};
+
+		/**
+		 * @brief Take a chunk from the allocator data and link its slots into a free list. Does not call the out of
+		 * memory handler since pools call this with their lock held
+		 *
+		 * @return the first free slot or nullptr if there is not enough memory
+		 */
+		static inline FreeSlot *carve(AllocatorData &ad, Chunk *&chunks, const size_t chunkSize,
+									  const size_t slotSize) noexcept
+		{
+			const size_t count = std::max<size_t>((chunkSize - sizeof(Chunk)) / slotSize, 1);
+			uint8_t *memory = Allocator<uint8_t>(ad).try_allocate(sizeof(Chunk) + count * slotSize);
+			if (memory == nullptr)
+			{
+				return nullptr;
+			}
+
+			Chunk *chunk = reinterpret_cast<Chunk *>(memory);
+			chunk->next = chunks;
+			chunks = chunk;
+
+			uint8_t *first = memory + sizeof(Chunk);
+			for (size_t i = 0; i < count; ++i)
+			{
+				FreeSlot *slot = reinterpret_cast<FreeSlot *>(first + i * slotSize);
+				slot->next = i + 1 == count ? nullptr : reinterpret_cast<FreeSlot *>(first + (i + 1) * slotSize);
+			}
+			return reinterpret_cast<FreeSlot *>(first);
+		}
+
+		static inline void release(AllocatorData &ad, Chunk *&chunks)
+		{
+			Allocator<uint8_t> a(ad);
+			while (chunks != nullptr)
+			{
+				Chunk *next = chunks->next;
+				a.deallocate(reinterpret_cast<uint8_t *>(chunks));
+				chunks = next;
+			}
+		}
+	} // namespace Pool
+
+	template <class T>
+	class PoolAllocator;
+
+	/**
+	 * @brief Data shared by pool allocators. Has one free list of fixed size slots per size class (multiples of
+	 * #TemAllocator::MinimumAllocationSize up to #TemAllocator::PoolMaxSlotSize). Slots are carved from large chunks
+	 * taken from an AllocatorData. Chunks are only returned when the data is released or destroyed.
+	 */
+	class PoolAllocatorData
+	{
+	private:
+		using Mutex = std::mutex;
+		Mutex mutex;
+		AllocatorData &ad;
+		size_t chunkSize;
+		Pool::Chunk *chunks;
+		Pool::FreeSlot *freeLists[PoolClassCount];
+		size_t used;
+
+		template <class T>
+		friend class PoolAllocator;
+
+		void *allocate(const size_t poolClass)
+		{
+			std::unique_lock<Mutex> g(mutex);
+			Pool::FreeSlot *slot = freeLists[poolClass];
+			while (slot == nullptr)
+			{
+				slot = Pool::carve(ad, chunks, chunkSize, (poolClass + 1) * MinimumAllocationSize);
+				if (slot == nullptr)
+				{
+					// The handler may free slots into this pool. So, it is called without the pool lock
+					g.unlock();
+					if (!ad.handleOutOfMemory(chunkSize))
+					{
+						throwBadAlloc();
+					}
+					g.lock();
+					slot = freeLists[poolClass];
+				}
+			}
+			freeLists[poolClass] = slot->next;
+			used += (poolClass + 1) * MinimumAllocationSize;
+			return slot;
+		}
+
+		void deallocate(void *p, const size_t poolClass) noexcept
+		{
+			std::lock_guard<Mutex> g(mutex);
+			Pool::FreeSlot *slot = static_cast<Pool::FreeSlot *>(p);
+			slot->next = freeLists[poolClass];
+			freeLists[poolClass] = slot;
+			used -= (poolClass + 1) * MinimumAllocationSize;
+		}
+
+	public:
+		explicit PoolAllocatorData(AllocatorData &ad, const size_t chunkSize = PoolChunkSize) noexcept
+			: mutex(), ad(ad), chunkSize(chunkSize), chunks(nullptr), freeLists(), used(0)
+		{
+		}
+		PoolAllocatorData(const PoolAllocatorData &) = delete;
+		PoolAllocatorData(PoolAllocatorData &&) = delete;
+
+		~PoolAllocatorData()
+		{
+			release();
+		}
+
+		AllocatorData &getData() const noexcept
+		{
+			return ad;
+		}
+
+		/**
+		 * @brief Get number of bytes in slots that are in use
+		 *
+		 * @return bytes in use
+		 */
+		size_t getUsed() const noexcept
+		{
+			return used;
+		}
+
+		/**
+		 * @brief Return every chunk to the allocator data. Invalidates all pointers from the pools
+		 */
+		void release() noexcept
+		{
+			std::lock_guard<Mutex> g(mutex);
+			Pool::release(ad, chunks);
+			for (size_t i = 0; i < PoolClassCount; ++i)
+			{
+				freeLists[i] = nullptr;
+			}
+			used = 0;
+		}
+	};
+
+	/**
+	 * @brief Allocator that serves single objects from fixed size pools. Meant for node based containers (i.e.
+	 * std::list, std::map) which always allocate one node at a time. Arrays and large types are passed to
+	 * #TemAllocator::Allocator.
+	 *
+	 * @tparam T type to allocate
+	 */
+	template <class T>
+	class PoolAllocator
+	{
+	public:
+		typedef T value_type;
+
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+		typedef std::false_type propagate_on_container_copy_assignment;
+		typedef std::false_type is_always_equal;
+
+		template <class U>
+		friend class PoolAllocator;
+
+	private:
+		PoolAllocatorData *pd;
+
+	public:
+		PoolAllocator(PoolAllocatorData &pd) noexcept : pd(&pd)
+		{
+		}
+
+		template <class U>
+		PoolAllocator(const PoolAllocator<U> &u) noexcept : pd(u.pd)
+		{
+		}
+		template <class U>
+		bool operator==(const PoolAllocator<U> &u) const noexcept
+		{
+			return pd == u.pd;
+		}
+		template <class U>
+		bool operator!=(const PoolAllocator<U> &u) const noexcept
+		{
+			return pd != u.pd;
+		}
+
+		PoolAllocatorData &getData() const noexcept
+		{
+			return *pd;
+		}
+
+		T *allocate(const size_t n = 1)
+		{
+			if (isPoolable<T>() && n == 1)
+			{
+				return static_cast<T *>(pd->allocate(getPoolClass<T>()));
+			}
+			return Allocator<T>(pd->ad).allocate(n);
+		}
+
+		void deallocate(T *const p, const size_t n = 1) noexcept
+		{
+			if (p == nullptr)
+			{
+				return;
+			}
+			if (isPoolable<T>() && n == 1)
+			{
+				pd->deallocate(p, getPoolClass<T>());
+				return;
+			}
+			Allocator<T>(pd->ad).deallocate(p, n);
+		}
+	};
+
+	/**
+	 * @brief Pool of objects of one type. Allocate and deallocate only push and pop an intrusive free list. Not thread
+	 * safe.
+	 *
+	 * @tparam T type of the objects
+	 */
+	template <class T>
+	class ObjectPool
+	{
+	private:
+		static constexpr size_t SlotSize =
+			(std::max(sizeof(T), sizeof(Pool::FreeSlot)) + MinimumAllocationSize - 1) & ~(MinimumAllocationSize - 1);
+
+		static_assert(alignof(T) <= MinimumAllocationSize, "ObjectPool can't align the type");
+
+		AllocatorData &ad;
+		size_t chunkSize;
+		Pool::Chunk *chunks;
+		Pool::FreeSlot *freeList;
+		size_t count;
+
+	public:
+		explicit ObjectPool(AllocatorData &ad, const size_t chunkSize = PoolChunkSize) noexcept
+			: ad(ad), chunkSize(chunkSize), chunks(nullptr), freeList(nullptr), count(0)
+		{
+		}
+		ObjectPool(const ObjectPool &) = delete;
+		ObjectPool(ObjectPool &&) = delete;
+
+		/**
+		 * @brief Returns every chunk to the allocator data. Objects that were not destroyed are not destroyed
+		 */
+		~ObjectPool()
+		{
+			Pool::release(ad, chunks);
+		}
+
+		/**
+		 * @brief Get number of objects in use
+		 *
+		 * @return number of objects
+		 */
+		size_t size() const noexcept
+		{
+			return count;
+		}
+
+		T *allocate()
+		{
+			while (freeList == nullptr)
+			{
+				freeList = Pool::carve(ad, chunks, chunkSize, SlotSize);
+				if (freeList == nullptr && !ad.handleOutOfMemory(chunkSize))
+				{
+					throwBadAlloc();
+				}
+			}
+			Pool::FreeSlot *slot = freeList;
+			freeList = slot->next;
+			++count;
+			return reinterpret_cast<T *>(slot);
+		}
+
+		void deallocate(T *const p) noexcept
+		{
+			Pool::FreeSlot *slot = reinterpret_cast<Pool::FreeSlot *>(p);
+			slot->next = freeList;
+			freeList = slot;
+			--count;
+		}
+
+		template <typename... Args>
+		T *create(Args &&...args)
+		{
+			T *t = allocate();
+#if __cpp_exceptions
+			try
+			{
+				new (t) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				deallocate(t);
+				throw;
+			}
+#else
+			new (t) T(std::forward<Args>(args)...);
+#endif
+			return t;
+		}
+
+		void destroy(T *const t)
+		{
+			if (t == nullptr)
+			{
+				return;
+			}
+			t->~T();
+			deallocate(t);
+		}
+	};
+} // namespace TemAllocator
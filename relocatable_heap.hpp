@@ -0,0 +1,365 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace TemAllocator
+{
+	/**
+	 * @brief Reference to a block allocated by #TemAllocator::RelocatableHeap. A handle stays valid when its block is
+	 * moved. The generation detects use after free.
+	 */
+	struct Handle
+	{
+		uint32_t index;
+		uint32_t generation;
+
+		bool operator==(const Handle &h) const noexcept
+		{
+			return index == h.index && generation == h.generation;
+		}
+		bool operator!=(const Handle &h) const noexcept
+		{
+			return !(*this == h);
+		}
+	};
+
+	constexpr Handle NullHandle = {std::numeric_limits<uint32_t>::max(), 0};
+
+	/**
+	 * @brief Allocates blocks that can be moved by an incremental compactor. Blocks are accessed through handles and
+	 * must be pinned while a raw pointer to them is used. Pinned blocks are never moved.
+	 *
+	 * All blocks of the AllocatorData must be allocated through the same RelocatableHeap so the compactor knows which
+	 * handle owns the block after a free block.
+	 */
+	class RelocatableHeap
+	{
+	private:
+		struct Entry
+		{
+			uint8_t *ptr;
+			size_t size;
+			uint32_t generation;
+			uint32_t pins;
+			uint32_t nextFree;
+		};
+
+		/**
+		 * Stored in front of every block so the compactor can find the handle of the block it moves
+		 */
+		struct BlockPrefix
+		{
+			size_t index;
+			size_t unused;
+		};
+
+		static constexpr uint32_t NoEntry = std::numeric_limits<uint32_t>::max();
+
+		AllocatorData &ad;
+		// Not allocated from ad since the table is not relocatable
+		std::vector<Entry> entries;
+		uint32_t freeEntry;
+		size_t movedBytes;
+
+		Entry *getEntry(const Handle h) noexcept
+		{
+			if (h.index >= entries.size())
+			{
+				return nullptr;
+			}
+			Entry &e = entries[h.index];
+			return e.ptr != nullptr && e.generation == h.generation ? &e : nullptr;
+		}
+
+	public:
+		explicit RelocatableHeap(AllocatorData &ad) : ad(ad), entries(), freeEntry(NoEntry), movedBytes(0)
+		{
+		}
+		RelocatableHeap(const RelocatableHeap &) = delete;
+		RelocatableHeap(RelocatableHeap &&) = delete;
+
+		/**
+		 * @brief Allocate a relocatable block
+		 *
+		 * @param size size of the block in bytes
+		 *
+		 * @return handle to the block
+		 */
+		Handle allocate(const size_t size)
+		{
+			if (size > std::numeric_limits<size_t>::max() - sizeof(BlockPrefix))
+			{
+				throwBadAlloc();
+			}
+			const size_t bytes = sizeof(BlockPrefix) + std::max<size_t>(size, 1);
+			std::unique_lock<AllocatorData::Mutex> g(ad.mutex);
+
+			uint8_t *block = Allocator<uint8_t>(ad).try_allocate(bytes);
+			while (block == nullptr)
+			{
+				// The handler may free blocks of this heap. So, it is called without the arena lock
+				g.unlock();
+				if (!ad.handleOutOfMemory(bytes))
+				{
+					throwBadAlloc();
+				}
+				g.lock();
+				block = Allocator<uint8_t>(ad).try_allocate(bytes);
+			}
+
+			uint32_t index = freeEntry;
+			if (index == NoEntry)
+			{
+				index = static_cast<uint32_t>(entries.size());
+#if __cpp_exceptions
+				try
+				{
+					entries.push_back(Entry{nullptr, 0, 0, 0, NoEntry});
+				}
+				catch (...)
+				{
+					Allocator<uint8_t>(ad).deallocate(block);
+					throw;
+				}
+#else
+				entries.push_back(Entry{nullptr, 0, 0, 0, NoEntry});
+#endif
+			}
+
+			Entry &e = entries[index];
+			freeEntry = e.nextFree;
+			e.ptr = block + sizeof(BlockPrefix);
+			e.size = size;
+			e.pins = 0;
+			e.nextFree = NoEntry;
+			reinterpret_cast<BlockPrefix *>(block)->index = index;
+			return Handle{index, e.generation};
+		}
+
+		/**
+		 * @brief Free a block. Does nothing if the handle is not valid
+		 *
+		 * @param h the handle
+		 */
+		void deallocate(const Handle h)
+		{
+			std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+
+			Entry *e = getEntry(h);
+			if (e == nullptr)
+			{
+				return;
+			}
+			Allocator<uint8_t>(ad).deallocate(e->ptr - sizeof(BlockPrefix));
+			e->ptr = nullptr;
+			e->size = 0;
+			++e->generation;
+			e->nextFree = freeEntry;
+			freeEntry = h.index;
+		}
+
+		/**
+		 * @brief Check if a handle refers to a live block
+		 *
+		 * @param h the handle
+		 *
+		 * @return true if valid
+		 */
+		bool isValid(const Handle h)
+		{
+			std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+			return getEntry(h) != nullptr;
+		}
+
+		/**
+		 * @brief Get the requested size of a block
+		 *
+		 * @param h the handle
+		 *
+		 * @return size in bytes or 0 if the handle is not valid
+		 */
+		size_t getSize(const Handle h)
+		{
+			std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+			Entry *e = getEntry(h);
+			return e == nullptr ? 0 : e->size;
+		}
+
+		/**
+		 * @brief Prevent the block from moving and get its address. Must be matched with #unpin
+		 *
+		 * @param h the handle
+		 *
+		 * @return the address or nullptr if the handle is not valid
+		 */
+		void *pin(const Handle h)
+		{
+			std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+			Entry *e = getEntry(h);
+			if (e == nullptr)
+			{
+				return nullptr;
+			}
+			++e->pins;
+			return e->ptr;
+		}
+
+		void unpin(const Handle h)
+		{
+			std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+			Entry *e = getEntry(h);
+			if (e != nullptr && e->pins > 0)
+			{
+				--e->pins;
+			}
+		}
+
+		/**
+		 * @brief Pins a block for the lifetime of this object
+		 *
+		 * @tparam T type stored in the block
+		 */
+		template <typename T>
+		class Pin
+		{
+		private:
+			RelocatableHeap &heap;
+			Handle handle;
+			T *ptr;
+
+		public:
+			Pin(RelocatableHeap &heap, const Handle handle)
+				: heap(heap), handle(handle), ptr(static_cast<T *>(heap.pin(handle)))
+			{
+			}
+			Pin(const Pin &) = delete;
+			Pin(Pin &&) = delete;
+
+			~Pin()
+			{
+				if (ptr != nullptr)
+				{
+					heap.unpin(handle);
+				}
+			}
+
+			T *get() const noexcept
+			{
+				return ptr;
+			}
+			T *operator->() const noexcept
+			{
+				return ptr;
+			}
+			T &operator*() const noexcept
+			{
+				return *ptr;
+			}
+			explicit operator bool() const noexcept
+			{
+				return ptr != nullptr;
+			}
+		};
+
+		/**
+		 * @brief Get the total number of bytes moved by #compact
+		 *
+		 * @return bytes moved
+		 */
+		size_t getMovedBytes() const noexcept
+		{
+			return movedBytes;
+		}
+
+		/**
+		 * @brief Slide unpinned blocks toward the start of the heap. Each block after a free block is moved into the
+		 * free block and the free space that moves behind it is merged with the next free block.
+		 *
+		 * @param budget Maximum number of bytes to move. Bounds the time the heap is locked. At least one block is
+		 * moved if possible
+		 *
+		 * @return true if no more blocks can be moved
+		 */
+		bool compact(const size_t budget = std::numeric_limits<size_t>::max())
+		{
+			std::lock_guard<AllocatorData::Mutex> g(ad.mutex);
+
+			// Blocks in the quick lists are not in the free list. They would look like blocks owned by a handle.
+			ad.consolidateQuickLists();
+			// Free nodes are moved below. Searches start from the head again afterwards
+			ad.placement.reset();
+
+			const size_t end = reinterpret_cast<size_t>(ad.data) + ad.len;
+			size_t moved = 0;
+
+			FreeListNode *prev = nullptr;
+			FreeListNode *freeNode = ad.list;
+			while (freeNode != nullptr)
+			{
+				const size_t blockAddress = reinterpret_cast<size_t>(freeNode) + freeNode->blockSize;
+				if (blockAddress >= end)
+				{
+					break;
+				}
+
+				FreeListNode *block = reinterpret_cast<FreeListNode *>(blockAddress);
+				const BlockPrefix *prefix = reinterpret_cast<const BlockPrefix *>(blockAddress + sizeof(FreeListNode));
+				Entry &e = entries[prefix->index];
+				if (e.pins > 0 || reinterpret_cast<size_t>(block) == reinterpret_cast<size_t>(freeNode->next))
+				{
+					prev = freeNode;
+					freeNode = freeNode->next;
+					continue;
+				}
+
+				const size_t blockSize = block->blockSize;
+				if (moved > 0 && moved + blockSize > budget)
+				{
+					movedBytes += moved;
+					return false;
+				}
+
+				const size_t gap = freeNode->blockSize;
+				FreeListNode *next = freeNode->next;
+				memmove(freeNode, block, blockSize);
+				e.ptr = reinterpret_cast<uint8_t *>(freeNode) + sizeof(FreeListNode) + sizeof(BlockPrefix);
+
+				FreeListNode *newFreeNode = reinterpret_cast<FreeListNode *>(reinterpret_cast<size_t>(freeNode) + blockSize);
+				newFreeNode->blockSize = gap;
+				newFreeNode->next = next;
+				if (prev == nullptr)
+				{
+					ad.list = newFreeNode;
+				}
+				else
+				{
+					prev->next = newFreeNode;
+				}
+				ad.coalescence(prev, newFreeNode);
+
+				moved += blockSize;
+				freeNode = newFreeNode;
+			}
+			movedBytes += moved;
+			return true;
+		}
+	};
+} // namespace TemAllocator
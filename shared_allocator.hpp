@@ -0,0 +1,725 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TemAllocator
+{
+	constexpr uint64_t SharedHeapMagic = 0x50414548484d4554ULL; // "TEMHHEAP"
+	constexpr uint32_t SharedHeapVersion = 1;
+
+	/**
+	 * @brief Linked list used by the shared memory allocator. Links are offsets from the start of the shared region so
+	 * the region can be mapped at a different address in each process. 0 is null since the region starts with its
+	 * header.
+	 */
+	struct SharedFreeListNode
+	{
+		size_t blockSize;
+		size_t next;
+	};
+
+	/**
+	 * @brief Stored at the start of the shared region
+	 */
+	struct SharedHeapHeader
+	{
+		uint64_t magic;
+		uint32_t version;
+		PlacementPolicy policy;
+		pthread_mutex_t mutex;
+		size_t length;
+		size_t list;
+		size_t used;
+		size_t allocationNum;
+		size_t root;
+	};
+
+	class SharedHeapError : public std::runtime_error
+	{
+	public:
+		explicit SharedHeapError(const std::string &message) : std::runtime_error(message)
+		{
+		}
+	};
+
+	/**
+	 * @brief Free list allocator data placed in shared memory (shm_open or memfd_create).
+	 *
+	 * Every process that maps the region gets its own SharedAllocatorData. The free list and the lock live in the
+	 * region. The lock is a process shared robust mutex. So, a process that dies while holding it does not block the
+	 * others. The next process to take the lock checks the heap. If the dead process left it in a state that cannot be
+	 * repaired, the lock is left unrecoverable and every later call fails. Pointers are only valid in the process that
+	 * created them. Use #toOffset and #fromOffset to pass allocations to other processes.
+	 */
+	class SharedAllocatorData
+	{
+	private:
+		SharedHeapHeader *header;
+		int fd;
+		size_t len;
+
+		template <class T>
+		friend class SharedAllocator;
+
+		class Lock
+		{
+		private:
+			pthread_mutex_t *mutex;
+			bool locked;
+
+		public:
+			explicit Lock(SharedAllocatorData &d) noexcept : mutex(&d.header->mutex), locked(false)
+			{
+				const int result = pthread_mutex_lock(mutex);
+				if (result == 0)
+				{
+					locked = true;
+				}
+				else if (result == EOWNERDEAD)
+				{
+					// The previous owner died while holding the lock. It may have been in the middle of changing the
+					// free list. Only keep using the heap if it still adds up. Otherwise, unlocking without marking
+					// the mutex consistent makes it unrecoverable for every process.
+					if (d.recover())
+					{
+						pthread_mutex_consistent(mutex);
+						locked = true;
+					}
+					else
+					{
+						pthread_mutex_unlock(mutex);
+					}
+				}
+			}
+			~Lock()
+			{
+				if (locked)
+				{
+					pthread_mutex_unlock(mutex);
+				}
+			}
+
+			bool owns() const noexcept
+			{
+				return locked;
+			}
+		};
+
+		static constexpr size_t getArenaOffset()
+		{
+			return (sizeof(SharedHeapHeader) + MinimumAllocationSize - 1) & ~(MinimumAllocationSize - 1);
+		}
+
+		/**
+		 * @brief Get the end of the last block. Block sizes are multiples of #TemAllocator::MinimumAllocationSize
+		 */
+		static size_t getArenaEnd(const size_t length) noexcept
+		{
+			return getArenaOffset() + ((length - getArenaOffset()) & ~(MinimumAllocationSize - 1));
+		}
+
+		uint8_t *base() const noexcept
+		{
+			return reinterpret_cast<uint8_t *>(header);
+		}
+
+		SharedFreeListNode *node(const size_t offset) const noexcept
+		{
+			return offset == 0 ? nullptr : reinterpret_cast<SharedFreeListNode *>(base() + offset);
+		}
+
+		size_t offset(const SharedFreeListNode *n) const noexcept
+		{
+			return n == nullptr ? 0 : static_cast<size_t>(reinterpret_cast<const uint8_t *>(n) - base());
+		}
+
+		void insert(const size_t previous, const size_t newNode) noexcept
+		{
+			if (previous == 0)
+			{
+				node(newNode)->next = header->list;
+				header->list = newNode;
+			}
+			else
+			{
+				node(newNode)->next = node(previous)->next;
+				node(previous)->next = newNode;
+			}
+		}
+
+		void remove(const size_t previous, const size_t deleteNode) noexcept
+		{
+			if (previous == 0)
+			{
+				header->list = node(deleteNode)->next;
+			}
+			else
+			{
+				node(previous)->next = node(deleteNode)->next;
+			}
+		}
+
+		/**
+		 * @brief Find a valid memory block. See #TemAllocator::PlacementPolicy
+		 *
+		 * @param size Requested memory block size
+		 * @param previousNode [out] the node before the foundNode
+		 * @param foundNode [out] the node that contains the request memory block
+		 */
+		void find(const size_t size, size_t &previousNode, size_t &foundNode) const noexcept
+		{
+			size_t smallestDiff = std::numeric_limits<size_t>::max();
+			previousNode = 0;
+			foundNode = 0;
+			size_t prev = 0;
+			for (size_t it = header->list; it != 0; it = node(it)->next)
+			{
+				const size_t blockSize = node(it)->blockSize;
+				if (blockSize >= size && blockSize - size < smallestDiff)
+				{
+					previousNode = prev;
+					foundNode = it;
+					smallestDiff = blockSize - size;
+					if (header->policy == PlacementPolicy::First || smallestDiff == 0)
+					{
+						return;
+					}
+				}
+				prev = it;
+			}
+		}
+
+		void coalescence(const size_t previousNode, const size_t freeNode) noexcept
+		{
+			SharedFreeListNode *f = node(freeNode);
+			if (f->next != 0 && freeNode + f->blockSize == f->next)
+			{
+				f->blockSize += node(f->next)->blockSize;
+				remove(freeNode, f->next);
+			}
+			SharedFreeListNode *p = node(previousNode);
+			if (p != nullptr && previousNode + p->blockSize == freeNode)
+			{
+				p->blockSize += f->blockSize;
+				remove(previousNode, freeNode);
+			}
+		}
+
+		/**
+		 * @brief Check the heap after a process died while holding the lock. Walks every block in address order and
+		 * checks that the free list links the free ones in order. The counters are rebuilt from the walk.
+		 *
+		 * @return true if the heap is usable
+		 */
+		bool recover() noexcept
+		{
+			const size_t end = getArenaEnd(header->length);
+			size_t freeNode = header->list;
+			size_t used = 0;
+			size_t num = 0;
+			for (size_t it = getArenaOffset(); it < end;)
+			{
+				// A free node that is not at the start of a block
+				if (freeNode != 0 && freeNode < it)
+				{
+					return false;
+				}
+				const size_t blockSize = node(it)->blockSize;
+				if (blockSize < sizeof(SharedFreeListNode) || blockSize > end - it ||
+					blockSize % MinimumAllocationSize != 0)
+				{
+					return false;
+				}
+				if (it == freeNode)
+				{
+					freeNode = node(it)->next;
+				}
+				else
+				{
+					used += blockSize;
+					++num;
+				}
+				it += blockSize;
+			}
+			if (freeNode != 0)
+			{
+				return false;
+			}
+			header->used = used;
+			header->allocationNum = num;
+			return true;
+		}
+
+		void map(const size_t len)
+		{
+			void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED)
+			{
+				fail("Failed to map shared heap");
+			}
+			header = static_cast<SharedHeapHeader *>(p);
+			this->len = len;
+		}
+
+		void initialize(const size_t len, const PlacementPolicy policy)
+		{
+			if (len <= getArenaOffset() + sizeof(SharedFreeListNode))
+			{
+				errno = 0;
+				fail("Shared heap is too small");
+			}
+			if (ftruncate(fd, static_cast<off_t>(len)) != 0)
+			{
+				fail("Failed to resize shared heap");
+			}
+			map(len);
+
+			pthread_mutexattr_t attr;
+			pthread_mutexattr_init(&attr);
+			pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+			pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+			pthread_mutex_init(&header->mutex, &attr);
+			pthread_mutexattr_destroy(&attr);
+
+			header->version = SharedHeapVersion;
+			header->policy = policy;
+			header->length = len;
+			header->used = 0;
+			header->allocationNum = 0;
+			header->root = 0;
+
+			SharedFreeListNode *first = node(getArenaOffset());
+			first->blockSize = getArenaEnd(len) - getArenaOffset();
+			first->next = 0;
+			header->list = getArenaOffset();
+
+			// Written last so a process that opens the region early does not see a partial header
+			__atomic_store_n(&header->magic, SharedHeapMagic, __ATOMIC_RELEASE);
+		}
+
+		void attach()
+		{
+			struct stat st;
+			if (fstat(fd, &st) != 0)
+			{
+				fail("Failed to stat shared heap");
+			}
+			if (static_cast<size_t>(st.st_size) < sizeof(SharedHeapHeader))
+			{
+				errno = 0;
+				fail("Shared heap is not initialized");
+			}
+			map(static_cast<size_t>(st.st_size));
+			errno = 0;
+			if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SharedHeapMagic)
+			{
+				fail("Region is not a shared heap");
+			}
+			if (header->version != SharedHeapVersion || header->length != len)
+			{
+				fail("Shared heap was created by an incompatible version");
+			}
+		}
+
+		[[noreturn]] void fail(const char *message)
+		{
+			const int error = errno;
+			close();
+			std::string s(message);
+			if (error != 0)
+			{
+				s += ": ";
+				s += strerror(error);
+			}
+			throwError(s);
+		}
+
+		/**
+		 * @brief Throw #TemAllocator::SharedHeapError. Aborts when exceptions are disabled
+		 */
+		[[noreturn]] static void throwError(const std::string &message)
+		{
+#if __cpp_exceptions
+			throw SharedHeapError(message);
+#else
+			(void)message;
+			abort();
+#endif
+		}
+
+	public:
+		SharedAllocatorData() noexcept : header(nullptr), fd(-1), len(0)
+		{
+		}
+		SharedAllocatorData(const SharedAllocatorData &) = delete;
+		SharedAllocatorData(SharedAllocatorData &&) = delete;
+
+		~SharedAllocatorData()
+		{
+			close();
+		}
+
+		/**
+		 * @brief Create a named shared heap with shm_open. Fails if the name exists
+		 *
+		 * @param name Name of the shared memory object (i.e. "/my-heap")
+		 * @param len Size of the heap in bytes
+		 * @param policy
+		 */
+		void create(const char *name, const size_t len, const PlacementPolicy policy = PlacementPolicy::Best)
+		{
+			close();
+			fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (fd < 0)
+			{
+				fail("Failed to create shared heap");
+			}
+			initialize(len, policy);
+		}
+
+		/**
+		 * @brief Open a named shared heap that another process created
+		 *
+		 * @param name Name of the shared memory object
+		 */
+		void open(const char *name)
+		{
+			close();
+			fd = shm_open(name, O_RDWR, 0600);
+			if (fd < 0)
+			{
+				fail("Failed to open shared heap");
+			}
+			attach();
+		}
+
+#if __linux__
+		/**
+		 * @brief Create an anonymous shared heap with memfd_create. Share it by forking or by passing #getFd to another
+		 * process
+		 *
+		 * @param len Size of the heap in bytes
+		 * @param policy
+		 */
+		void createAnonymous(const size_t len, const PlacementPolicy policy = PlacementPolicy::Best)
+		{
+			close();
+			fd = memfd_create("TemAllocator", MFD_CLOEXEC);
+			if (fd < 0)
+			{
+				fail("Failed to create shared heap");
+			}
+			initialize(len, policy);
+		}
+#endif
+
+		/**
+		 * @brief Open a shared heap from a file descriptor. The descriptor is duplicated
+		 *
+		 * @param fd the file descriptor
+		 */
+		void openFd(const int fd)
+		{
+			close();
+			this->fd = dup(fd);
+			if (this->fd < 0)
+			{
+				fail("Failed to duplicate shared heap descriptor");
+			}
+			attach();
+		}
+
+		/**
+		 * @brief Unmap the heap. Other processes are not affected
+		 */
+		void close() noexcept
+		{
+			if (header != nullptr)
+			{
+				munmap(header, len);
+				header = nullptr;
+				len = 0;
+			}
+			if (fd >= 0)
+			{
+				::close(fd);
+				fd = -1;
+			}
+		}
+
+		/**
+		 * @brief Remove the name of a shared heap. Processes that have it open can keep using it
+		 *
+		 * @param name Name of the shared memory object
+		 */
+		static void unlink(const char *name) noexcept
+		{
+			shm_unlink(name);
+		}
+
+		int getFd() const noexcept
+		{
+			return fd;
+		}
+
+		size_t getTotal() const noexcept
+		{
+			return header == nullptr ? 0 : getArenaEnd(header->length) - getArenaOffset();
+		}
+
+		size_t getUsed() const noexcept
+		{
+			return header == nullptr ? 0 : __atomic_load_n(&header->used, __ATOMIC_RELAXED);
+		}
+
+		size_t getNum() const noexcept
+		{
+			return header == nullptr ? 0 : __atomic_load_n(&header->allocationNum, __ATOMIC_RELAXED);
+		}
+
+		bool owns(const void *p) const noexcept
+		{
+			const uint8_t *b = static_cast<const uint8_t *>(p);
+			return header != nullptr && b >= base() + getArenaOffset() && b < base() + len;
+		}
+
+		/**
+		 * @brief Convert a pointer into the heap to a value that is valid in every process
+		 *
+		 * @param p the pointer
+		 *
+		 * @return the offset or 0 for nullptr
+		 */
+		size_t toOffset(const void *p) const noexcept
+		{
+			return p == nullptr ? 0 : static_cast<size_t>(static_cast<const uint8_t *>(p) - base());
+		}
+
+		/**
+		 * @brief Convert an offset from #toOffset to a pointer in this process
+		 *
+		 * @param offset the offset
+		 *
+		 * @return the pointer or nullptr for 0
+		 */
+		template <typename T = void>
+		T *fromOffset(const size_t offset) const noexcept
+		{
+			return offset == 0 ? nullptr : reinterpret_cast<T *>(base() + offset);
+		}
+
+		/**
+		 * @brief Store the offset of the object that other processes should start from
+		 *
+		 * @param offset the offset
+		 */
+		void setRoot(const size_t offset) noexcept
+		{
+			__atomic_store_n(&header->root, offset, __ATOMIC_RELEASE);
+		}
+
+		size_t getRoot() const noexcept
+		{
+			return __atomic_load_n(&header->root, __ATOMIC_ACQUIRE);
+		}
+
+		/**
+		 * @brief Allocate a block of memory
+		 *
+		 * @param requestedSize size in bytes
+		 *
+		 * @return pointer to allocated data
+		 */
+		void *allocate(const size_t requestedSize)
+		{
+			if (requestedSize == 0)
+			{
+				return nullptr;
+			}
+			if (header == nullptr || requestedSize > header->length)
+			{
+				throwBadAlloc();
+			}
+
+			const size_t size = (std::max(requestedSize, MinimumAllocationSize) + MinimumAllocationSize - 1) &
+								~(MinimumAllocationSize - 1);
+			const size_t allocateSize = size + sizeof(SharedFreeListNode);
+
+			Lock l(*this);
+			if (!l.owns())
+			{
+				throwError("Shared heap is not recoverable");
+			}
+
+			size_t previousNode;
+			size_t affectedNode;
+			find(allocateSize, previousNode, affectedNode);
+			if (affectedNode == 0)
+			{
+				throwBadAlloc();
+			}
+
+			SharedFreeListNode *n = node(affectedNode);
+			const size_t rest = n->blockSize - allocateSize;
+			if (rest > 0)
+			{
+				const size_t newFreeNode = affectedNode + allocateSize;
+				node(newFreeNode)->blockSize = rest;
+				node(newFreeNode)->next = 0;
+				insert(affectedNode, newFreeNode);
+			}
+
+			remove(previousNode, affectedNode);
+			n->blockSize = allocateSize;
+			n->next = 0;
+
+			header->used += allocateSize;
+			++header->allocationNum;
+			return base() + affectedNode + sizeof(SharedFreeListNode);
+		}
+
+		/**
+		 * @brief Free a block of memory. May be called from any process that has the heap open
+		 *
+		 * @param ptr the pointer
+		 */
+		void deallocate(void *ptr) noexcept
+		{
+			if (ptr == nullptr)
+			{
+				return;
+			}
+
+			// The block is leaked if the heap is not recoverable
+			Lock l(*this);
+			if (!l.owns())
+			{
+				return;
+			}
+
+			const size_t freeNode = toOffset(ptr) - sizeof(SharedFreeListNode);
+			node(freeNode)->next = 0;
+
+			size_t prev = 0;
+			size_t it = header->list;
+			while (it != 0 && it < freeNode)
+			{
+				prev = it;
+				it = node(it)->next;
+			}
+			insert(prev, freeNode);
+
+			header->used -= node(freeNode)->blockSize;
+			--header->allocationNum;
+
+			coalescence(prev, freeNode);
+		}
+
+		/**
+		 * @brief Get size of block from pointer
+		 *
+		 * @param ptr the pointer
+		 *
+		 * @return The size of the block
+		 */
+		size_t getBlockSize(const void *ptr) const noexcept
+		{
+			if (ptr == nullptr)
+			{
+				return 0;
+			}
+			return reinterpret_cast<const SharedFreeListNode *>(static_cast<const uint8_t *>(ptr) -
+																 sizeof(SharedFreeListNode))
+				->blockSize;
+		}
+	};
+
+	/**
+	 * @brief Allocator for memory in a shared heap. Containers using it must only be accessed from the process that
+	 * created them since they store pointers.
+	 *
+	 * @tparam T type to allocate
+	 */
+	template <class T>
+	class SharedAllocator
+	{
+	public:
+		typedef T value_type;
+
+		typedef std::true_type propagate_on_container_move_assignment;
+		typedef std::true_type propagate_on_container_swap;
+		typedef std::false_type propagate_on_container_copy_assignment;
+		typedef std::false_type is_always_equal;
+
+		template <class U>
+		friend class SharedAllocator;
+
+	private:
+		SharedAllocatorData *ad;
+
+	public:
+		SharedAllocator(SharedAllocatorData &ad) noexcept : ad(&ad)
+		{
+		}
+
+		template <class U>
+		SharedAllocator(const SharedAllocator<U> &u) noexcept : ad(u.ad)
+		{
+		}
+		template <class U>
+		bool operator==(const SharedAllocator<U> &u) const noexcept
+		{
+			return ad == u.ad;
+		}
+		template <class U>
+		bool operator!=(const SharedAllocator<U> &u) const noexcept
+		{
+			return ad != u.ad;
+		}
+
+		SharedAllocatorData &getData() const noexcept
+		{
+			return *ad;
+		}
+
+		T *allocate(const size_t n = 1)
+		{
+			if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			{
+				throwBadAlloc();
+			}
+			return static_cast<T *>(ad->allocate(sizeof(T) * n));
+		}
+
+		void deallocate(T *const p, const size_t = 1) noexcept
+		{
+			ad->deallocate(p);
+		}
+	};
+} // namespace TemAllocator
@@ -0,0 +1,460 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#pragma once
+
+#include "engine_allocator.hpp"
+
+#include <cstdint>
+
+namespace TemAllocator
+{
+	constexpr size_t SoaGranuleSize = MinimumAllocationSize;
+
+	/**
+	 * @brief Free list allocator engine that keeps the free list outside of the heap. The offsets and sizes of the free
+	 * blocks are stored in two arrays sorted by address (structure of arrays, in granules). A search only streams the
+	 * size array instead of touching one cold cache line per free block. The scan loops are branch free so the
+	 * compiler can vectorize them and the next chunk is prefetched while the current one is compared.
+	 *
+	 * Allocated blocks start with a header holding their size. Free blocks store nothing.
+	 */
+	class SoaAllocatorData
+	{
+	private:
+		/**
+		 * Stored at the start of every allocated block
+		 */
+		struct BlockHeader
+		{
+			size_t granules;
+			size_t unused;
+		};
+
+		static constexpr size_t ScanChunk = 64;
+		static constexpr uint32_t NotFound = std::numeric_limits<uint32_t>::max();
+
+		using Mutex = std::mutex;
+		Mutex mutex;
+		uint8_t *data;
+		size_t len;
+		// Offsets of the free blocks in granules. Sorted
+		uint32_t *offsets;
+		// Sizes of the free blocks in granules
+		uint32_t *sizes;
+		size_t count;
+		size_t capacity;
+		size_t used;
+		size_t allocationNum;
+		PlacementPolicy policy;
+		bool ownsData;
+
+		/**
+		 * @brief Find the free block with the smallest size that is at least the requested size. Stops at the end of
+		 * the chunk that has an exact match.
+		 *
+		 * @param granules requested size
+		 *
+		 * @return index in the arrays or count if there is none
+		 */
+		size_t findBest(const uint32_t granules) const noexcept
+		{
+			uint32_t best = NotFound;
+			for (size_t start = 0; start < count && best != granules; start += ScanChunk)
+			{
+				const size_t end = std::min(start + ScanChunk, count);
+				if (end + ScanChunk < count)
+				{
+					__builtin_prefetch(sizes + end + ScanChunk);
+				}
+				uint32_t chunkBest = NotFound;
+				for (size_t i = start; i < end; ++i)
+				{
+					// Blocks that are too small become NotFound
+					const uint32_t s = sizes[i] | (0u - static_cast<uint32_t>(sizes[i] < granules));
+					chunkBest = std::min(s, chunkBest);
+				}
+				best = chunkBest < best ? chunkBest : best;
+			}
+			if (best == NotFound)
+			{
+				return count;
+			}
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (sizes[i] == best)
+				{
+					return i;
+				}
+			}
+			return count;
+		}
+
+		/**
+		 * @brief Find the first free block that is big enough. Each chunk is tested without branches first.
+		 *
+		 * @param granules requested size
+		 *
+		 * @return index in the arrays or count if there is none
+		 */
+		size_t findFirst(const uint32_t granules) const noexcept
+		{
+			for (size_t start = 0; start < count; start += ScanChunk)
+			{
+				const size_t end = std::min(start + ScanChunk, count);
+				if (end + ScanChunk < count)
+				{
+					__builtin_prefetch(sizes + end + ScanChunk);
+				}
+				uint32_t largest = 0;
+				for (size_t i = start; i < end; ++i)
+				{
+					largest = std::max(sizes[i], largest);
+				}
+				if (largest < granules)
+				{
+					continue;
+				}
+				for (size_t i = start; i < end; ++i)
+				{
+					if (sizes[i] >= granules)
+					{
+						return i;
+					}
+				}
+			}
+			return count;
+		}
+
+		/**
+		 * @brief Get the index of the first free block after an offset
+		 */
+		size_t upperBound(const uint32_t offset) const noexcept
+		{
+			return static_cast<size_t>(std::upper_bound(offsets, offsets + count, offset) - offsets);
+		}
+
+		void erase(const size_t i) noexcept
+		{
+			memmove(offsets + i, offsets + i + 1, (count - i - 1) * sizeof(uint32_t));
+			memmove(sizes + i, sizes + i + 1, (count - i - 1) * sizeof(uint32_t));
+			--count;
+		}
+
+		/**
+		 * @brief Make room in the arrays for a number of free blocks
+		 *
+		 * @param n number of free blocks
+		 */
+		void reserve(const size_t n)
+		{
+			if (n <= capacity)
+			{
+				return;
+			}
+			const size_t newCapacity = std::max<size_t>(n, capacity == 0 ? 64 : capacity * 2);
+			uint32_t *newOffsets = static_cast<uint32_t *>(realloc(offsets, newCapacity * sizeof(uint32_t)));
+			if (newOffsets == nullptr)
+			{
+				throwBadAlloc();
+			}
+			offsets = newOffsets;
+			uint32_t *newSizes = static_cast<uint32_t *>(realloc(sizes, newCapacity * sizeof(uint32_t)));
+			if (newSizes == nullptr)
+			{
+				throwBadAlloc();
+			}
+			sizes = newSizes;
+			capacity = newCapacity;
+		}
+
+		/**
+		 * @brief Insert a free block. There must be room for it (see #reserve)
+		 */
+		void insert(const size_t i, const uint32_t offset, const uint32_t size) noexcept
+		{
+			memmove(offsets + i + 1, offsets + i, (count - i) * sizeof(uint32_t));
+			memmove(sizes + i + 1, sizes + i, (count - i) * sizeof(uint32_t));
+			offsets[i] = offset;
+			sizes[i] = size;
+			++count;
+		}
+
+		static uint32_t toGranules(const size_t bytes) noexcept
+		{
+			return static_cast<uint32_t>((bytes + sizeof(BlockHeader) + SoaGranuleSize - 1) / SoaGranuleSize);
+		}
+
+		BlockHeader *getHeader(const void *ptr) const noexcept
+		{
+			return reinterpret_cast<BlockHeader *>(reinterpret_cast<size_t>(ptr) - sizeof(BlockHeader));
+		}
+
+		uint32_t getOffset(const BlockHeader *header) const noexcept
+		{
+			return static_cast<uint32_t>((reinterpret_cast<const uint8_t *>(header) - data) / SoaGranuleSize);
+		}
+
+		void *allocateLocked(const size_t bytes)
+		{
+			if (bytes > len)
+			{
+				throwBadAlloc();
+			}
+			const uint32_t granules = toGranules(std::max<size_t>(bytes, 1));
+			// There is at most one more free block than allocated blocks. Make room for the free block that freeing
+			// this allocation may add now, so deallocate never has to allocate
+			reserve(allocationNum + 2);
+			const size_t i = policy == PlacementPolicy::First ? findFirst(granules) : findBest(granules);
+			if (i == count)
+			{
+				throwBadAlloc();
+			}
+
+			const uint32_t offset = offsets[i];
+			if (sizes[i] == granules)
+			{
+				erase(i);
+			}
+			else
+			{
+				// The rest of the block stays at the same position in the sorted arrays
+				offsets[i] += granules;
+				sizes[i] -= granules;
+			}
+
+			BlockHeader *header = reinterpret_cast<BlockHeader *>(data + static_cast<size_t>(offset) * SoaGranuleSize);
+			header->granules = granules;
+			used += granules * SoaGranuleSize;
+			++allocationNum;
+			return data + static_cast<size_t>(offset) * SoaGranuleSize + sizeof(BlockHeader);
+		}
+
+		void deallocateLocked(void *ptr) noexcept
+		{
+			const BlockHeader *header = getHeader(ptr);
+			uint32_t offset = getOffset(header);
+			uint32_t granules = static_cast<uint32_t>(header->granules);
+			used -= granules * SoaGranuleSize;
+			--allocationNum;
+
+			size_t i = upperBound(offset);
+			const bool mergePrevious = i > 0 && offsets[i - 1] + sizes[i - 1] == offset;
+			const bool mergeNext = i < count && offset + granules == offsets[i];
+			if (mergePrevious && mergeNext)
+			{
+				sizes[i - 1] += granules + sizes[i];
+				erase(i);
+			}
+			else if (mergePrevious)
+			{
+				sizes[i - 1] += granules;
+			}
+			else if (mergeNext)
+			{
+				offsets[i] = offset;
+				sizes[i] += granules;
+			}
+			else
+			{
+				insert(i, offset, granules);
+			}
+		}
+
+		void close()
+		{
+			if (data != nullptr && ownsData)
+			{
+				free(data);
+			}
+			free(offsets);
+			free(sizes);
+			data = nullptr;
+			offsets = nullptr;
+			sizes = nullptr;
+			count = 0;
+			capacity = 0;
+			ownsData = false;
+			len = 0;
+		}
+
+		void reset(const size_t len, const PlacementPolicy policy)
+		{
+			const size_t granules = len / SoaGranuleSize;
+			if (granules >= NotFound)
+			{
+				close();
+				throwBadAlloc();
+			}
+			this->len = granules * SoaGranuleSize;
+			this->policy = policy;
+			used = 0;
+			allocationNum = 0;
+			reserve(1);
+			insert(0, 0, static_cast<uint32_t>(granules));
+		}
+
+	public:
+		SoaAllocatorData() noexcept
+			: mutex(), data(nullptr), len(0), offsets(nullptr), sizes(nullptr), count(0), capacity(0), used(0),
+			  allocationNum(0), policy(PlacementPolicy::Best), ownsData(false)
+		{
+		}
+		SoaAllocatorData(const SoaAllocatorData &) = delete;
+		SoaAllocatorData(SoaAllocatorData &&) = delete;
+
+		~SoaAllocatorData()
+		{
+			close();
+		}
+
+		size_t getTotal() const
+		{
+			return len;
+		}
+
+		size_t getUsed() const
+		{
+			return used;
+		}
+
+		size_t getNum() const
+		{
+			return allocationNum;
+		}
+
+		/**
+		 * @brief Get the number of free blocks
+		 *
+		 * @return number of free blocks
+		 */
+		size_t getFreeBlocks() const
+		{
+			return count;
+		}
+
+		/**
+		 * Reset and re-allocate data. Does NOT re-assign pointers that were using the old memory block. Only use at startup
+		 *
+		 * @param len Amount of total memory to use. At most 64 GiB
+		 * @param policy
+		 */
+		void init(const size_t len, const PlacementPolicy policy = PlacementPolicy::Best)
+		{
+			close();
+			data = static_cast<uint8_t *>(malloc(len));
+			if (data == nullptr)
+			{
+				throwBadAlloc();
+			}
+			ownsData = true;
+			reset(len, policy);
+		}
+
+		/**
+		 * Reset and use memory owned by the caller. Only use at startup
+		 *
+		 * @param buffer Memory to use. Must be aligned to #TemAllocator::SoaGranuleSize
+		 * @param len Size of the buffer in bytes. At most 64 GiB
+		 * @param policy
+		 */
+		void init(void *buffer, const size_t len, const PlacementPolicy policy = PlacementPolicy::Best)
+		{
+			close();
+			data = static_cast<uint8_t *>(buffer);
+			reset(len, policy);
+		}
+
+		void *allocate(const size_t bytes)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			return allocateLocked(bytes);
+		}
+
+		/**
+		 * @brief Resize a block. Grows in place when the block after it is free and big enough
+		 *
+		 * @param ptr the block
+		 * @param bytes the new size
+		 *
+		 * @return the block
+		 */
+		void *reallocate(void *ptr, const size_t bytes)
+		{
+			std::lock_guard<Mutex> g(mutex);
+			if (ptr == nullptr)
+			{
+				return allocateLocked(bytes);
+			}
+			if (bytes > len)
+			{
+				throwBadAlloc();
+			}
+			BlockHeader *header = getHeader(ptr);
+			const uint32_t oldGranules = static_cast<uint32_t>(header->granules);
+			if (bytes + sizeof(BlockHeader) <= oldGranules * SoaGranuleSize)
+			{
+				return ptr;
+			}
+
+			const uint32_t granules = toGranules(bytes);
+			const uint32_t end = getOffset(header) + oldGranules;
+			const size_t i = upperBound(end - 1);
+			if (i < count && offsets[i] == end && sizes[i] >= granules - oldGranules)
+			{
+				const uint32_t extra = granules - oldGranules;
+				if (sizes[i] == extra)
+				{
+					erase(i);
+				}
+				else
+				{
+					offsets[i] += extra;
+					sizes[i] -= extra;
+				}
+				header->granules = granules;
+				used += extra * SoaGranuleSize;
+				return ptr;
+			}
+
+			void *newPtr = allocateLocked(bytes);
+			memcpy(newPtr, ptr, oldGranules * SoaGranuleSize - sizeof(BlockHeader));
+			deallocateLocked(ptr);
+			return newPtr;
+		}
+
+		void deallocate(void *ptr) noexcept
+		{
+			if (ptr == nullptr)
+			{
+				return;
+			}
+			std::lock_guard<Mutex> g(mutex);
+			deallocateLocked(ptr);
+		}
+
+		size_t getBlockSize(const void *ptr) const
+		{
+			if (ptr == nullptr)
+			{
+				return 0;
+			}
+			return getHeader(ptr)->granules * SoaGranuleSize - sizeof(BlockHeader);
+		}
+	};
+
+	template <class T>
+	using SoaAllocator = EngineAllocator<T, SoaAllocatorData>;
+} // namespace TemAllocator
@@ -0,0 +1,421 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "tem_malloc.hpp"
+#include "linear_allocator.hpp"
+
+#include <cerrno>
+#include <new>
+#include <type_traits>
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef TEM_ALLOCATOR_OVERRIDE_MALLOC
+#define TEM_ALLOCATOR_OVERRIDE_MALLOC 0
+#endif
+
+#ifndef TEM_ALLOCATOR_OVERRIDE_NEW
+#define TEM_ALLOCATOR_OVERRIDE_NEW 0
+#endif
+
+#ifndef __THROW
+#define __THROW
+#endif
+
+namespace TemAllocator
+{
+	namespace
+	{
+		constexpr size_t DefaultMallocHeapSize = sizeof(void *) >= 8 ? (size_t(1) << 32) : (size_t(1) << 28);
+
+		size_t getMallocHeapSize() noexcept
+		{
+			// getenv does not allocate. So, it is safe to call before the heap exists.
+			const char *s = getenv("TEM_ALLOCATOR_HEAP_SIZE");
+			if (s == nullptr)
+			{
+				return DefaultMallocHeapSize;
+			}
+			const size_t size = static_cast<size_t>(strtoull(s, nullptr, 10));
+			return size == 0 ? DefaultMallocHeapSize : alignForward(size, MinimumAllocationSize);
+		}
+
+		AllocatorData *mallocHeap = nullptr;
+
+		void lockBeforeFork()
+		{
+			mallocHeap->beforeFork();
+		}
+
+		void unlockInParent()
+		{
+			mallocHeap->afterForkParent();
+		}
+
+		void resetInChild()
+		{
+			mallocHeap->afterForkChild();
+		}
+
+		AllocatorData *createMallocHeap() noexcept
+		{
+			// Never destroyed. Other static destructors may still free memory at exit.
+			static typename std::aligned_storage<sizeof(AllocatorData), alignof(AllocatorData)>::type storage;
+			AllocatorData *ad = new (&storage) AllocatorData();
+
+			const size_t len = getMallocHeapSize();
+			void *buffer =
+				mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (buffer != MAP_FAILED)
+			{
+				ad->init(buffer, len, PlacementPolicy::First, true);
+			}
+
+			// A thread may hold the lock while another thread forks. The child would never be able to take it.
+			mallocHeap = ad;
+			pthread_atfork(lockBeforeFork, unlockInParent, resetInChild);
+			return ad;
+		}
+
+		/**
+		 * @brief Allocations with a large alignment store a header in front of the aligned pointer. Its block size is 0
+		 * (which a real block never has) and next points to the pointer returned by the heap.
+		 *
+		 * @param ptr a pointer returned by tem_malloc or tem_memalign
+		 *
+		 * @return the pointer returned by the heap
+		 */
+		uint8_t *getHeapPointer(void *ptr) noexcept
+		{
+			const FreeListNode *header =
+				reinterpret_cast<const FreeListNode *>(reinterpret_cast<size_t>(ptr) - sizeof(FreeListNode));
+			if (header->blockSize == 0)
+			{
+				return reinterpret_cast<uint8_t *>(header->next);
+			}
+			return static_cast<uint8_t *>(ptr);
+		}
+	} // namespace
+
+	AllocatorData &getMallocHeap()
+	{
+		static AllocatorData *const heap = createMallocHeap();
+		return *heap;
+	}
+} // namespace TemAllocator
+
+using namespace TemAllocator;
+
+extern "C"
+{
+	void *tem_malloc(size_t size)
+	{
+		void *ptr = Allocator<uint8_t>(getMallocHeap()).try_allocate(std::max<size_t>(size, 1));
+		if (ptr == nullptr)
+		{
+			errno = ENOMEM;
+		}
+		return ptr;
+	}
+
+	void tem_free(void *ptr)
+	{
+		AllocatorData &heap = getMallocHeap();
+		if (ptr == nullptr || !heap.owns(ptr))
+		{
+			return;
+		}
+		Allocator<uint8_t>(heap).deallocate(getHeapPointer(ptr));
+	}
+
+	size_t tem_malloc_usable_size(void *ptr)
+	{
+		AllocatorData &heap = getMallocHeap();
+		if (ptr == nullptr || !heap.owns(ptr))
+		{
+			return 0;
+		}
+		uint8_t *heapPtr = getHeapPointer(ptr);
+		const size_t offset = static_cast<uint8_t *>(ptr) - heapPtr;
+		return Allocator<uint8_t>(heap).getBlockSize(heapPtr) - sizeof(FreeListNode) - offset;
+	}
+
+	void *tem_realloc(void *ptr, size_t size)
+	{
+		if (ptr == nullptr)
+		{
+			return tem_malloc(size);
+		}
+		if (size == 0)
+		{
+			tem_free(ptr);
+			return nullptr;
+		}
+
+		AllocatorData &heap = getMallocHeap();
+		if (!heap.owns(ptr))
+		{
+			// The size of a foreign block is unknown. So, it can't be copied.
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		uint8_t *heapPtr = getHeapPointer(ptr);
+		if (heapPtr == ptr)
+		{
+			void *newPtr = Allocator<uint8_t>(heap).try_reallocate(heapPtr, size);
+			if (newPtr == nullptr)
+			{
+				errno = ENOMEM;
+			}
+			return newPtr;
+		}
+
+		// Aligned blocks must keep their alignment. So, always move them.
+		void *newPtr = tem_malloc(size);
+		if (newPtr != nullptr)
+		{
+			memcpy(newPtr, ptr, std::min(size, tem_malloc_usable_size(ptr)));
+			tem_free(ptr);
+		}
+		return newPtr;
+	}
+
+	void *tem_calloc(size_t count, size_t size)
+	{
+		if (size != 0 && count > std::numeric_limits<size_t>::max() / size)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+		// Only clears memory that was handed out before. Fresh pages are already zero.
+		void *ptr = Allocator<uint8_t>(getMallocHeap()).try_allocate_zeroed(std::max<size_t>(count * size, 1));
+		if (ptr == nullptr)
+		{
+			errno = ENOMEM;
+		}
+		return ptr;
+	}
+
+	void *tem_memalign(size_t alignment, size_t size)
+	{
+		if (!isPowerOfTwo(alignment) || alignment == 0)
+		{
+			errno = EINVAL;
+			return nullptr;
+		}
+		if (alignment <= MinimumAllocationSize)
+		{
+			return tem_malloc(size);
+		}
+		if (size > std::numeric_limits<size_t>::max() - alignment)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		uint8_t *heapPtr = static_cast<uint8_t *>(tem_malloc(size + alignment));
+		if (heapPtr == nullptr)
+		{
+			return nullptr;
+		}
+		const size_t address = alignForward(reinterpret_cast<size_t>(heapPtr), alignment);
+		if (address == reinterpret_cast<size_t>(heapPtr))
+		{
+			return heapPtr;
+		}
+
+		// Heap pointers are aligned to MinimumAllocationSize. So, there is always room for the header.
+		FreeListNode *header = reinterpret_cast<FreeListNode *>(address - sizeof(FreeListNode));
+		header->blockSize = 0;
+		header->next = reinterpret_cast<FreeListNode *>(heapPtr);
+		return reinterpret_cast<void *>(address);
+	}
+
+#if TEM_ALLOCATOR_OVERRIDE_MALLOC
+	void *malloc(size_t size) __THROW
+	{
+		return tem_malloc(size);
+	}
+	void free(void *ptr) __THROW
+	{
+		tem_free(ptr);
+	}
+	void *realloc(void *ptr, size_t size) __THROW
+	{
+		return tem_realloc(ptr, size);
+	}
+	void *calloc(size_t count, size_t size) __THROW
+	{
+		return tem_calloc(count, size);
+	}
+	void *memalign(size_t alignment, size_t size) __THROW
+	{
+		return tem_memalign(alignment, size);
+	}
+	void *aligned_alloc(size_t alignment, size_t size) __THROW
+	{
+		return tem_memalign(alignment, size);
+	}
+	int posix_memalign(void **ptr, size_t alignment, size_t size) __THROW
+	{
+		if (alignment % sizeof(void *) != 0 || !isPowerOfTwo(alignment) || alignment == 0)
+		{
+			return EINVAL;
+		}
+		void *p = tem_memalign(alignment, size);
+		if (p == nullptr)
+		{
+			return ENOMEM;
+		}
+		*ptr = p;
+		return 0;
+	}
+	void *valloc(size_t size) __THROW
+	{
+		return tem_memalign(sysconf(_SC_PAGESIZE), size);
+	}
+	void *pvalloc(size_t size) __THROW
+	{
+		const size_t pageSize = sysconf(_SC_PAGESIZE);
+		return tem_memalign(pageSize, alignForward(size, pageSize));
+	}
+	size_t malloc_usable_size(void *ptr) __THROW
+	{
+		return tem_malloc_usable_size(ptr);
+	}
+#endif
+}
+
+#if TEM_ALLOCATOR_OVERRIDE_NEW
+namespace
+{
+	void *allocateOrThrow(const size_t size, const size_t alignment)
+	{
+		while (true)
+		{
+			void *ptr = alignment <= MinimumAllocationSize ? tem_malloc(size) : tem_memalign(alignment, size);
+			if (ptr != nullptr)
+			{
+				return ptr;
+			}
+			std::new_handler handler = std::get_new_handler();
+			if (handler == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+
+	void *allocateOrNull(const size_t size, const size_t alignment) noexcept
+	{
+		try
+		{
+			return allocateOrThrow(size, alignment);
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+	}
+} // namespace
+
+void *operator new(size_t size)
+{
+	return allocateOrThrow(size, MinimumAllocationSize);
+}
+void *operator new[](size_t size)
+{
+	return allocateOrThrow(size, MinimumAllocationSize);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return allocateOrNull(size, MinimumAllocationSize);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return allocateOrNull(size, MinimumAllocationSize);
+}
+void operator delete(void *ptr) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete[](void *ptr) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete[](void *ptr, size_t) noexcept
+{
+	tem_free(ptr);
+}
+
+#if __cpp_aligned_new
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return allocateOrNull(size, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return allocateOrNull(size, static_cast<size_t>(alignment));
+}
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+	tem_free(ptr);
+}
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+	tem_free(ptr);
+}
+#endif
+#endif
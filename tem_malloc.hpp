@@ -0,0 +1,52 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <cstddef>
+
+/**
+ * C interface to a process wide free list heap.
+ *
+ * The heap is created on first use from an anonymous mapping whose size is read from the TEM_ALLOCATOR_HEAP_SIZE
+ * environment variable (in bytes). Pages are only committed when touched.
+ *
+ * Compile tem_malloc.cpp with TEM_ALLOCATOR_OVERRIDE_MALLOC=1 to also export malloc, free, etc. and with
+ * TEM_ALLOCATOR_OVERRIDE_NEW=1 to replace the global operator new and delete. For example, a library that can be used
+ * with LD_PRELOAD:
+ *
+ *     g++ -std=c++17 -O2 -shared -fPIC -DTEM_ALLOCATOR_OVERRIDE_MALLOC=1 -DTEM_ALLOCATOR_OVERRIDE_NEW=1 \
+ *         tem_malloc.cpp -o libtemallocator.so -lpthread
+ */
+extern "C"
+{
+	void *tem_malloc(size_t size);
+	void tem_free(void *ptr);
+	void *tem_realloc(void *ptr, size_t size);
+	void *tem_calloc(size_t count, size_t size);
+	void *tem_memalign(size_t alignment, size_t size);
+	size_t tem_malloc_usable_size(void *ptr);
+}
+
+namespace TemAllocator
+{
+	/**
+	 * @brief Get the heap used by tem_malloc. Creates the heap if needed
+	 *
+	 * @return the heap
+	 */
+	AllocatorData &getMallocHeap();
+} // namespace TemAllocator
@@ -0,0 +1,597 @@
+/******************************************************************************
+	Copyright (C) 2022 by Temitope Alaga <temdog007@yaoo.com>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 2 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "allocator.hpp"
+
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace TemAllocator
+{
+	/**
+	 * @brief Types whose objects can be moved to another address by copying their bytes, without calling the move
+	 * constructor or the destructor. Specialize it for types that are not trivially copyable but can still be moved
+	 * like that (i.e. types that only own heap memory).
+	 *
+	 * @tparam T the type
+	 */
+	template <class T>
+	struct IsTriviallyRelocatable : std::is_trivially_copyable<T>
+	{
+	};
+
+	/**
+	 * @brief Vector that grows with #TemAllocator::Allocator::reallocate when T is trivially relocatable. The block is
+	 * then extended into the free block after it instead of allocating, copying and freeing. Other types are moved into
+	 * a new block like std::vector does. The capacity is always all of the block the allocator returned.
+	 *
+	 * @tparam T the element type
+	 * @tparam Data the data to allocate from (see #TemAllocator::BasicAllocatorData)
+	 */
+	template <class T, class Data = AllocatorData>
+	class Vector
+	{
+	public:
+		typedef T value_type;
+		typedef Allocator<T, Data> allocator_type;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		typedef T &reference;
+		typedef const T &const_reference;
+		typedef T *pointer;
+		typedef const T *const_pointer;
+		typedef T *iterator;
+		typedef const T *const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	private:
+		allocator_type allocator;
+		T *items;
+		size_t count;
+		size_t itemCapacity;
+
+		static constexpr bool relocatable = IsTriviallyRelocatable<T>::value;
+
+		/**
+		 * @brief Move the elements into a new block that holds at least a number of T's. The old block is kept if a move
+		 * throws
+		 *
+		 * @param minimum the capacity. Must not be less than the size
+		 */
+		void moveTo(const size_t minimum)
+		{
+			const allocation_result<T *> result = allocator.allocate_at_least(minimum);
+#if __cpp_exceptions
+			try
+			{
+				std::uninitialized_move(items, items + count, result.ptr);
+			}
+			catch (...)
+			{
+				allocator.deallocate(result.ptr, result.count);
+				throw;
+			}
+#else
+			std::uninitialized_move(items, items + count, result.ptr);
+#endif
+			std::destroy(items, items + count);
+			allocator.deallocate(items, itemCapacity);
+			items = result.ptr;
+			itemCapacity = result.count;
+		}
+
+		/**
+		 * @brief Change the capacity to hold at least a number of T's. Must not be less than the size
+		 *
+		 * @param minimum the capacity
+		 */
+		void setCapacity(const size_t minimum)
+		{
+			if constexpr (relocatable)
+			{
+				items = allocator.reallocate(items, minimum);
+				itemCapacity = (allocator.getBlockSize(items) - sizeof(FreeListNode)) / sizeof(T);
+			}
+			else
+			{
+				moveTo(minimum);
+			}
+		}
+
+		/**
+		 * @brief Make room for a number of T's after the last one. The capacity at least doubles
+		 */
+		void grow(const size_t n)
+		{
+			if (n > itemCapacity - count)
+			{
+				if (n > max_size() - count)
+				{
+					throwBadAlloc();
+				}
+				setCapacity(std::max<size_t>(count + n, itemCapacity * 2));
+			}
+		}
+
+		/**
+		 * @brief Construct copies of a range after the last element
+		 */
+		template <class InputIt>
+		void append(InputIt first, InputIt last)
+		{
+			if constexpr (std::is_base_of<std::forward_iterator_tag,
+										  typename std::iterator_traits<InputIt>::iterator_category>::value)
+			{
+				grow(static_cast<size_t>(std::distance(first, last)));
+			}
+			for (; first != last; ++first)
+			{
+				emplace_back(*first);
+			}
+		}
+
+		void release() noexcept
+		{
+			clear();
+			allocator.deallocate(items, itemCapacity);
+			items = nullptr;
+			itemCapacity = 0;
+		}
+
+	public:
+		/**
+		 * @brief Use the arena from #TemAllocator::ScopedArena::current
+		 */
+		Vector() noexcept : allocator(), items(nullptr), count(0), itemCapacity(0)
+		{
+		}
+		explicit Vector(const allocator_type &allocator) noexcept
+			: allocator(allocator), items(nullptr), count(0), itemCapacity(0)
+		{
+		}
+		explicit Vector(const size_t n, const allocator_type &allocator = allocator_type()) : Vector(allocator)
+		{
+			resize(n);
+		}
+		Vector(const size_t n, const T &value, const allocator_type &allocator = allocator_type()) : Vector(allocator)
+		{
+			resize(n, value);
+		}
+		Vector(std::initializer_list<T> list, const allocator_type &allocator = allocator_type()) : Vector(allocator)
+		{
+			append(list.begin(), list.end());
+		}
+		template <class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+		Vector(InputIt first, InputIt last, const allocator_type &allocator = allocator_type()) : Vector(allocator)
+		{
+			append(first, last);
+		}
+		Vector(const Vector &other) : Vector(other.allocator)
+		{
+			reserve(other.count);
+			std::uninitialized_copy(other.items, other.items + other.count, items);
+			count = other.count;
+		}
+		Vector(Vector &&other) noexcept
+			: allocator(other.allocator), items(other.items), count(other.count), itemCapacity(other.itemCapacity)
+		{
+			other.items = nullptr;
+			other.count = 0;
+			other.itemCapacity = 0;
+		}
+
+		~Vector()
+		{
+			release();
+		}
+
+		/**
+		 * @brief Copy the elements. The allocator is kept (see #TemAllocator::Allocator)
+		 */
+		Vector &operator=(const Vector &other)
+		{
+			if (this != &other)
+			{
+				clear();
+				reserve(other.count);
+				std::uninitialized_copy(other.items, other.items + other.count, items);
+				count = other.count;
+			}
+			return *this;
+		}
+
+		/**
+		 * @brief Take the elements and the allocator
+		 */
+		Vector &operator=(Vector &&other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				allocator = other.allocator;
+				items = other.items;
+				count = other.count;
+				itemCapacity = other.itemCapacity;
+				other.items = nullptr;
+				other.count = 0;
+				other.itemCapacity = 0;
+			}
+			return *this;
+		}
+
+		/**
+		 * @brief Replace the elements with copies of a value
+		 *
+		 * @param n number of copies
+		 * @param value the value
+		 */
+		void assign(const size_t n, const T &value)
+		{
+			// The value may be an element
+			const T copy(value);
+			clear();
+			resize(n, copy);
+		}
+		/**
+		 * @brief Replace the elements with copies of a range. The range must not be in this vector
+		 */
+		template <class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+		void assign(InputIt first, InputIt last)
+		{
+			clear();
+			append(first, last);
+		}
+		void assign(std::initializer_list<T> list)
+		{
+			assign(list.begin(), list.end());
+		}
+
+		allocator_type get_allocator() const noexcept
+		{
+			return allocator;
+		}
+
+		iterator begin() noexcept
+		{
+			return items;
+		}
+		const_iterator begin() const noexcept
+		{
+			return items;
+		}
+		const_iterator cbegin() const noexcept
+		{
+			return items;
+		}
+		iterator end() noexcept
+		{
+			return items + count;
+		}
+		const_iterator end() const noexcept
+		{
+			return items + count;
+		}
+		const_iterator cend() const noexcept
+		{
+			return items + count;
+		}
+		reverse_iterator rbegin() noexcept
+		{
+			return reverse_iterator(end());
+		}
+		const_reverse_iterator rbegin() const noexcept
+		{
+			return const_reverse_iterator(end());
+		}
+		reverse_iterator rend() noexcept
+		{
+			return reverse_iterator(begin());
+		}
+		const_reverse_iterator rend() const noexcept
+		{
+			return const_reverse_iterator(begin());
+		}
+
+		size_t size() const noexcept
+		{
+			return count;
+		}
+		size_t capacity() const noexcept
+		{
+			return itemCapacity;
+		}
+		size_t max_size() const noexcept
+		{
+			return (std::numeric_limits<size_t>::max() - sizeof(FreeListNode)) / sizeof(T);
+		}
+		bool empty() const noexcept
+		{
+			return count == 0;
+		}
+		T *data() noexcept
+		{
+			return items;
+		}
+		const T *data() const noexcept
+		{
+			return items;
+		}
+
+		T &operator[](const size_t i) noexcept
+		{
+			return items[i];
+		}
+		const T &operator[](const size_t i) const noexcept
+		{
+			return items[i];
+		}
+		T &at(const size_t i)
+		{
+			if (i >= count)
+			{
+#if __cpp_exceptions
+				throw std::out_of_range("TemAllocator::Vector::at");
+#else
+				abort();
+#endif
+			}
+			return items[i];
+		}
+		const T &at(const size_t i) const
+		{
+			return const_cast<Vector *>(this)->at(i);
+		}
+		T &front() noexcept
+		{
+			return items[0];
+		}
+		const T &front() const noexcept
+		{
+			return items[0];
+		}
+		T &back() noexcept
+		{
+			return items[count - 1];
+		}
+		const T &back() const noexcept
+		{
+			return items[count - 1];
+		}
+
+		/**
+		 * @brief Make the capacity at least a number of T's
+		 *
+		 * @param n the capacity
+		 */
+		void reserve(const size_t n)
+		{
+			if (n > itemCapacity)
+			{
+				setCapacity(n);
+			}
+		}
+
+		/**
+		 * @brief Move the elements into a block that fits them. Frees the block if there are none
+		 */
+		void shrink_to_fit()
+		{
+			if (count == 0)
+			{
+				release();
+			}
+			else if (itemCapacity > allocator_type::good_size(count))
+			{
+				// reallocate never shrinks. So, always move
+				moveTo(count);
+			}
+		}
+
+		void clear() noexcept
+		{
+			std::destroy(items, items + count);
+			count = 0;
+		}
+
+		template <typename... Args>
+		T &emplace_back(Args &&...args)
+		{
+			if (count == itemCapacity)
+			{
+				// The arguments may refer to an element that growing moves
+				T value(std::forward<Args>(args)...);
+				grow(1);
+				new (items + count) T(std::move(value));
+			}
+			else
+			{
+				new (items + count) T(std::forward<Args>(args)...);
+			}
+			return items[count++];
+		}
+
+		void push_back(const T &value)
+		{
+			emplace_back(value);
+		}
+		void push_back(T &&value)
+		{
+			emplace_back(std::move(value));
+		}
+
+		void pop_back() noexcept
+		{
+			--count;
+			items[count].~T();
+		}
+
+		template <typename... Args>
+		iterator emplace(const_iterator position, Args &&...args)
+		{
+			const size_t index = static_cast<size_t>(position - items);
+			T value(std::forward<Args>(args)...);
+			grow(1);
+			if (index == count)
+			{
+				new (items + count) T(std::move(value));
+			}
+			else
+			{
+				new (items + count) T(std::move(items[count - 1]));
+				std::move_backward(items + index, items + count - 1, items + count);
+				items[index] = std::move(value);
+			}
+			++count;
+			return items + index;
+		}
+
+		iterator insert(const_iterator position, const T &value)
+		{
+			return emplace(position, value);
+		}
+		iterator insert(const_iterator position, T &&value)
+		{
+			return emplace(position, std::move(value));
+		}
+		/**
+		 * @brief Insert copies of a value. They are added at the end and rotated into place
+		 */
+		iterator insert(const_iterator position, const size_t n, const T &value)
+		{
+			const size_t index = static_cast<size_t>(position - items);
+			const size_t oldCount = count;
+			// The value may be an element that growing moves
+			const T copy(value);
+			grow(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				new (items + count) T(copy);
+				++count;
+			}
+			std::rotate(items + index, items + oldCount, items + count);
+			return items + index;
+		}
+		/**
+		 * @brief Insert copies of a range. They are added at the end and rotated into place. The range must not be in
+		 * this vector
+		 */
+		template <class InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+		iterator insert(const_iterator position, InputIt first, InputIt last)
+		{
+			const size_t index = static_cast<size_t>(position - items);
+			const size_t oldCount = count;
+			append(first, last);
+			std::rotate(items + index, items + oldCount, items + count);
+			return items + index;
+		}
+		iterator insert(const_iterator position, std::initializer_list<T> list)
+		{
+			return insert(position, list.begin(), list.end());
+		}
+
+		iterator erase(const_iterator position)
+		{
+			return erase(position, position + 1);
+		}
+		iterator erase(const_iterator first, const_iterator last)
+		{
+			T *const start = items + (first - items);
+			T *const stop = items + (last - items);
+			if (start != stop)
+			{
+				T *const newEnd = std::move(stop, items + count, start);
+				std::destroy(newEnd, items + count);
+				count = static_cast<size_t>(newEnd - items);
+			}
+			return start;
+		}
+
+		void resize(const size_t n)
+		{
+			if (n > count)
+			{
+				reserve(n);
+				for (; count < n; ++count)
+				{
+					new (items + count) T();
+				}
+			}
+			else
+			{
+				std::destroy(items + n, items + count);
+				count = n;
+			}
+		}
+		void resize(const size_t n, const T &value)
+		{
+			if (n > count)
+			{
+				// The value may be an element that growing moves
+				const T copy(value);
+				reserve(n);
+				for (; count < n; ++count)
+				{
+					new (items + count) T(copy);
+				}
+			}
+			else
+			{
+				std::destroy(items + n, items + count);
+				count = n;
+			}
+		}
+
+		/**
+		 * @brief Swap the elements and the allocators
+		 */
+		void swap(Vector &other) noexcept
+		{
+			std::swap(allocator, other.allocator);
+			std::swap(items, other.items);
+			std::swap(count, other.count);
+			std::swap(itemCapacity, other.itemCapacity);
+		}
+
+		bool operator==(const Vector &other) const
+		{
+			return count == other.count && std::equal(items, items + count, other.items);
+		}
+		bool operator!=(const Vector &other) const
+		{
+			return !(*this == other);
+		}
+		bool operator<(const Vector &other) const
+		{
+			return std::lexicographical_compare(items, items + count, other.items, other.items + other.count);
+		}
+		bool operator>(const Vector &other) const
+		{
+			return other < *this;
+		}
+		bool operator<=(const Vector &other) const
+		{
+			return !(other < *this);
+		}
+		bool operator>=(const Vector &other) const
+		{
+			return !(*this < other);
+		}
+	};
+} // namespace TemAllocator